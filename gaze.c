@@ -35,19 +35,46 @@
 /*******************************************************************************
 Headers
 *******************************************************************************/
+/* wait4() is not part of POSIX */
+#define _DEFAULT_SOURCE
+/* wcwidth() is part of X/Open */
+#define _XOPEN_SOURCE 700
+/* Wide character curses functions */
+#define _XOPEN_SOURCE_EXTENDED
+
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
 #include <time.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <locale.h>
+#include <wchar.h>
+#include <poll.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#ifdef __linux__
+    #include <sys/inotify.h>
+    #include <sys/vfs.h>
+    #include <linux/magic.h>
+#endif
+#ifdef __GLIBC__
+    #include <malloc.h>
+#endif
 #include <curses.h>
+#include "gaze_plugin.h"
 
 /*******************************************************************************
 Macros
@@ -67,6 +94,70 @@ Macros
     #define DEFAULT_TIMEOUT (5)
 #endif
 
+/* Default debounce for --on-change: one hundred milliseconds */
+#ifndef DEFAULT_DEBOUNCE
+    #define DEFAULT_DEBOUNCE (100)
+#endif
+
+/* Default frame rate limit in low bandwidth mode: four frames per second */
+#ifndef DEFAULT_MAX_FPS
+    #define DEFAULT_MAX_FPS (4)
+#endif
+
+/* Tables with at least this many rows are sorted in parallel */
+#ifndef TABLE_PARALLEL_ROWS
+    #define TABLE_PARALLEL_ROWS (65536)
+#endif
+
+/* Maximum number of threads used for sorting tables */
+#ifndef TABLE_MAX_THREADS
+    #define TABLE_MAX_THREADS (8)
+#endif
+
+/* Longest interval reached while idle: ten minutes */
+#ifndef IDLE_MAX_INTERVAL
+    #define IDLE_MAX_INTERVAL (600)
+#endif
+
+/* Number of runs kept for run time percentiles */
+#ifndef RUN_HISTORY
+    #define RUN_HISTORY (128)
+#endif
+
+/* Bytes scanned for line numbers between key reads when following the end */
+#ifndef TAIL_INDEX_CHUNK
+    #define TAIL_INDEX_CHUNK (8 * 1024 * 1024)
+#endif
+
+/* Maximum number of clients attached to a server */
+#ifndef MAX_CLIENTS
+    #define MAX_CLIENTS (64)
+#endif
+
+/* Share of time stalled on memory (PSI avg10 percent) that starts shedding */
+#ifndef MEMORY_PRESSURE
+    #define MEMORY_PRESSURE (10)
+#endif
+
+/* Interval is multiplied by this while memory is short */
+#ifndef MEMORY_PRESSURE_STRETCH
+    #define MEMORY_PRESSURE_STRETCH (4)
+#endif
+
+/* Maximum number of panes the screen can be split into */
+#ifndef MAX_PANES
+    #define MAX_PANES (4)
+#endif
+
+/* Room for the lines marking output left out or cut short by --keep-tail */
+#define ELIDE_MARKER_SIZE (96)
+
+/* Snapshot protocol magic: "gaz1" */
+#define SNAPSHOT_MAGIC (UINT32_C(0x677a6131))
+
+/* Longest command line accepted from a server */
+#define SNAPSHOT_MAX_CMD (1024 * 1024)
+
 /* Key codes */
 #define CTRL(x) ((x) & 0x1f)
 #define ESCAPE  CTRL('[')
@@ -84,8 +175,8 @@ Globals
 struct
 {
     size_t buffer_size;
+    size_t keep_tail;
     int    interval;
-    int    interval_digits;
     int    timeout;
     bool   show_lineno;
     char * cmd;
@@ -94,10 +185,16 @@ struct
     int    lines_digits;
     int    display_cols;
     time_t cmd_time;
+    char * serve_path;
+    char * attach_path;
+    char * file_path;
+    char * plugin_path;
+    int *  row_map; /* Source line of each displayed row, NULL if identical */
+    int    row_map_lines;
 } global = {
     /* buffer_size = */ DEFAULT_BUFFER_SIZE,
+    /* keep_tail = */ 0,
     /* interval = */ DEFAULT_INTERVAL,
-    /* interval_digits = */ 1,
     /* timeout = */ DEFAULT_TIMEOUT,
     /* show_lineno = */ false,
     /* cmd = */ NULL,
@@ -105,7 +202,13 @@ struct
     /* lines = */ 1,
     /* lines_digits = */ 1,
     /* display_cols = */ 1,
-    /* cmd_time = */ 0
+    /* cmd_time = */ 0,
+    /* serve_path = */ NULL,
+    /* attach_path = */ NULL,
+    /* file_path = */ NULL,
+    /* plugin_path = */ NULL,
+    /* row_map = */ NULL,
+    /* row_map_lines = */ 0
 };
 
 /*******************************************************************************
@@ -137,7 +240,13 @@ void sig_finish(int sig UNUSED)
     exit(1);
 }
 
-void sig_nothing(int sig UNUSED) { }
+/* Set when the command timer expires, reads may keep returning data */
+volatile sig_atomic_t timer_expired = 0;
+
+void sig_alarm(int sig UNUSED)
+{
+    timer_expired = 1;
+}
 
 void handle_signals()
 {
@@ -156,7 +265,7 @@ void handle_signals()
         }
         else if (i == SIGALRM)
         {
-            sa.sa_handler = &sig_nothing;
+            sa.sa_handler = &sig_alarm;
         }
         else
         {
@@ -187,22 +296,220 @@ void set_timer(unsigned int milliseconds)
     {
         exit_failed(1, "Error: setitimer(): %s", strerror(errno));
     }
+
+    timer_expired = 0;
+}
+
+/*******************************************************************************
+Run statistics
+
+Each run of the command is reaped with wait4() for its resource usage. The
+wall times of recent runs are kept in a ring to report their median and
+99th percentile.
+*******************************************************************************/
+struct
+{
+    bool   valid;
+    double wall;
+    double user;
+    double sys;
+    long   max_rss; /* Kilobytes */
+    int    status;
+    double history[RUN_HISTORY];
+    int    history_count;
+    int    history_next;
+    double p50;
+    double p99;
+} run = { false, 0, 0, 0, 0, 0, { 0 }, 0, 0, 0, 0 };
+
+int run_compare(const void * a, const void * b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+double run_seconds(struct timeval tv)
+{
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* Record a finished run, start is when the command was started */
+void run_record(const struct timespec * start,
+                int                     status,
+                const struct rusage *   usage)
+{
+    double          sorted[RUN_HISTORY];
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    run.valid   = true;
+    run.wall    = (now.tv_sec - start->tv_sec) +
+                  (now.tv_nsec - start->tv_nsec) / 1e9;
+    run.user    = run_seconds(usage->ru_utime);
+    run.sys     = run_seconds(usage->ru_stime);
+    run.max_rss = usage->ru_maxrss;
+    run.status  = status;
+
+    run.history[run.history_next] = run.wall;
+    run.history_next              = (run.history_next + 1) % RUN_HISTORY;
+
+    if (run.history_count < RUN_HISTORY)
+    {
+        run.history_count++;
+    }
+
+    memcpy(sorted, run.history, run.history_count * sizeof(*sorted));
+
+    qsort(sorted, run.history_count, sizeof(*sorted), &run_compare);
+
+    run.p50 = sorted[(run.history_count - 1) / 2];
+    run.p99 = sorted[(run.history_count - 1) * 99 / 100];
+}
+
+/* Format seconds in at most five characters */
+void run_format_time(char * s, size_t size, double seconds)
+{
+    if (seconds < 1)
+    {
+        snprintf(s, size, "%dms", (int)(seconds * 1000));
+    }
+    else if (seconds < 100)
+    {
+        snprintf(s, size, "%.1fs", seconds);
+    }
+    else
+    {
+        snprintf(s, size, "%ds", (int)seconds);
+    }
+}
+
+/* Format statistics of the last run for the header */
+void run_tag(char * tag, size_t size)
+{
+    char   wall[16];
+    char   user[16];
+    char   sys[16];
+    char   p50[16];
+    char   p99[16];
+    char   status[16];
+    double rss;
+    char   unit;
+
+    if (!run.valid)
+    {
+        tag[0] = '\0';
+
+        return;
+    }
+
+    run_format_time(wall, sizeof(wall), run.wall);
+    run_format_time(user, sizeof(user), run.user);
+    run_format_time(sys, sizeof(sys), run.sys);
+    run_format_time(p50, sizeof(p50), run.p50);
+    run_format_time(p99, sizeof(p99), run.p99);
+
+    if (WIFSIGNALED(run.status))
+    {
+        snprintf(status, sizeof(status), "sig %d", WTERMSIG(run.status));
+    }
+    else
+    {
+        snprintf(status, sizeof(status), "exit %d", WEXITSTATUS(run.status));
+    }
+
+    for (rss = run.max_rss, unit = 'k'; rss >= 1024 && unit != 'G';)
+    {
+        rss  /= 1024;
+        unit  = (unit == 'k') ? 'M' : 'G';
+    }
+
+    snprintf(tag,
+             size,
+             "%s %s u%s s%s %.*f%c p50 %s p99 %s  ",
+             status,
+             wall,
+             user,
+             sys,
+             (rss < 10) ? 1 : 0,
+             rss,
+             unit,
+             p50,
+             p99);
+}
+
+/*******************************************************************************
+Keep start and end of output larger than the buffer
+
+With --keep-tail the last bytes of output are kept in place of what does not
+fit after the first ones, a marker line in between tells how much was left
+out. Commands are read into a ring once the start is full so memory stays
+bounded however much they write.
+*******************************************************************************/
+uint64_t count_newlines(const char * s, size_t size)
+{
+    const char * end = s + size;
+    uint64_t     count;
+
+    for (count = 0; (s = (const char *)memchr(s, '\n', end - s)); s++)
+    {
+        count++;
+    }
+
+    return count;
+}
+
+/* Append marker and tail to head in buffer, return size of the result */
+size_t elide(char *       buffer,
+             size_t       head,
+             const char * tail,
+             size_t       tail_size,
+             uint64_t     bytes,
+             uint64_t     lines)
+{
+    const char * newline;
+    int          len;
+
+    /* The partial first line of the tail is left out too */
+    if ((newline = (const char *)memchr(tail, '\n', tail_size)))
+    {
+        bytes     += newline + 1 - tail;
+        lines     += 1;
+        tail_size -= newline + 1 - tail;
+        tail       = newline + 1;
+    }
+
+    len = snprintf(&buffer[head],
+                   ELIDE_MARKER_SIZE,
+                   "%s[%" PRIu64 " bytes / %" PRIu64 " lines elided]\n",
+                   (head && buffer[head - 1] != '\n') ? "\n" : "",
+                   bytes,
+                   lines);
+
+    memcpy(&buffer[head + len], tail, tail_size);
+
+    return head + len + tail_size;
 }
 
 /*******************************************************************************
 Execute command and read results to buffer from pipe
 *******************************************************************************/
-char * cmd_to_buffer(char * cmd)
+char * cmd_to_buffer(char * cmd, size_t * size)
 {
-    char * buffer;
-    int    pipefd[2];
-    int    pid;
+    struct timespec start;
+    char *          buffer;
+    int             pipefd[2];
+    int             pid;
 
     buffer = NULL; /* Fixes clang warning */
 
     /* Execute and read from process via pipe */
     pipe(pipefd);
 
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
     if (!(pid = fork()))
     {
         char * args[4];
@@ -230,180 +537,5018 @@ char * cmd_to_buffer(char * cmd)
 
         /* Execute command in shell */
         execvp(args[0], args);
+
+        _Exit(127); /* Avoid atexit() hooks */
     }
     else
     {
-        ssize_t retval;
-        size_t  size;
+        struct rusage usage;
+        ssize_t       retval;
+        int           status;
+        bool          timed_out;
+        size_t        head;
+        char *        ring;
+        size_t        ring_pos;
+        uint64_t      ring_bytes;
+        uint64_t      ring_lines;
+
+        if (!(buffer = (char *)malloc(global.buffer_size + ELIDE_MARKER_SIZE)))
+        {
+            return NULL;
+        }
+
+        /* Output beyond the first head bytes goes to a ring if kept */
+        head       = global.buffer_size - 1 - global.keep_tail;
+        ring       = NULL;
+        ring_pos   = 0;
+        ring_bytes = 0;
+        ring_lines = 0;
 
-        if (!(buffer = (char *)malloc(global.buffer_size)))
+        if (global.keep_tail && !(ring = (char *)malloc(global.keep_tail)))
         {
+            free(buffer);
+
             return NULL;
         }
 
         close(pipefd[1]);
 
-        /* Read from pipe to buffer (with timeout via SIGALRM + EINTR) */
+        /* Read from pipe to buffer (with timeout via SIGALRM) */
         set_timer(global.timeout * 1000);
 
-        size = 0;
+        *size = 0;
 
         do {
-            retval =
-                read(pipefd[0], &buffer[size], global.buffer_size - size - 1);
+            if (*size < head)
+            {
+                retval = read(pipefd[0], &buffer[*size], head - *size);
+
+                if (retval > 0)
+                {
+                    *size += retval;
 
-            if (retval > 0)
+                    if (*size == head && !ring) break;
+                }
+            }
+            else
             {
-                size += retval;
+                retval = read(pipefd[0],
+                              &ring[ring_pos],
+                              global.keep_tail - ring_pos);
 
-                if (size == global.buffer_size - 1) break;
+                if (retval > 0)
+                {
+                    ring_lines += count_newlines(&ring[ring_pos], retval);
+                    ring_bytes += retval;
+                    ring_pos    = (ring_pos + retval) % global.keep_tail;
+                }
             }
-        } while (retval > 0);
+        } while (retval > 0 && !timer_expired);
 
-        buffer[size] = '\0';
+        /* Commands that never stop writing are only stopped by the flag */
+        timed_out = timer_expired || (retval == -1 && errno == EINTR);
 
         set_timer(0); /* Clear timer */
 
-        /* Show error message on timeout */
-        if (retval == -1 && errno == EINTR)
+        /* Join the end of the output kept in the ring to its start */
+        if (ring_bytes <= global.keep_tail)
+        {
+            memcpy(&buffer[*size], ring, ring_bytes);
+
+            *size += ring_bytes;
+        }
+        else
+        {
+            char * tail;
+
+            if (!(tail = (char *)malloc(global.keep_tail)))
+            {
+                exit_failed(1, "Failed to allocate command output buffer");
+            }
+
+            /* Oldest byte of a full ring is the next one to be written */
+            memcpy(tail, &ring[ring_pos], global.keep_tail - ring_pos);
+            memcpy(&tail[global.keep_tail - ring_pos], ring, ring_pos);
+
+            *size = elide(buffer,
+                          *size,
+                          tail,
+                          global.keep_tail,
+                          ring_bytes - global.keep_tail,
+                          ring_lines - count_newlines(tail, global.keep_tail));
+
+            free(tail);
+        }
+
+        free(ring);
+
+        /* Show error message on timeout, after the output kept if any */
+        if (timed_out && global.keep_tail)
+        {
+            *size += snprintf(&buffer[*size],
+                              global.buffer_size + ELIDE_MARKER_SIZE - *size,
+                              "%s[COMMAND TIMED OUT]\n",
+                              (*size && buffer[*size - 1] != '\n') ? "\n" :
+                                                                     "");
+        }
+        else if (timed_out)
         {
             strncpy(buffer, "\n\n\t\tCOMMAND TIMED OUT", global.buffer_size);
 
             buffer[global.buffer_size - 1] = '\0';
+
+            *size = strlen(buffer);
+        }
+        else
+        {
+            buffer[*size] = '\0';
         }
 
-        /* Cleanup */
+        /* Cleanup, hang up on commands that timed out or filled buffer */
         close(pipefd[0]);
 
-        kill(SIGHUP, pid);
+        if (timed_out || retval != 0)
+        {
+            kill(pid, SIGHUP);
+        }
 
-        wait(NULL);
+        if (wait4(pid, &status, 0, &usage) == pid)
+        {
+            run_record(&start, status, &usage);
+        }
     }
 
     return buffer;
 }
 
 /*******************************************************************************
-Count characters required to print int
+Read file to buffer without a child process
+
+Regular files are copied out of a read-only mapping and are only read again
+once inotify reports a change, files without a size (procfs, sysfs, pipes)
+are read with pread() every interval. Empty regular files on other file
+systems are watched too, they are read again once they change.
 *******************************************************************************/
-int count_int_chars(int n)
+struct
 {
-    int digits = (n < 0) ? 2 : 1;
+    int  inotify_fd;
+    int  wd;
+    bool stale;
+} file = { -1, -1, true };
 
-    while ((n /= 10)) digits++;
+sigjmp_buf file_sigbus_env;
 
-    return digits;
+void file_sigbus(int sig UNUSED)
+{
+    siglongjmp(file_sigbus_env, 1);
 }
 
-/*******************************************************************************
-Create pad from buffer
-*******************************************************************************/
-WINDOW * newpad_buffer(const char * buffer, int * cols_count, int * lines_count)
+void file_init()
 {
-    WINDOW *     pad;
-    int          lines;
-    int          tmp;
-    int          cols;
-    const char * prev;
-    const char * s;
-    int          i;
+#ifdef __linux__
+    file.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
 
-    /* Calculate number of lines and columns in buffer */
-    lines = 1;
-    cols  = 1;
-    tmp   = 0;
+void file_watch(const char * path)
+{
+#ifdef __linux__
+    if (file.wd == -1 && file.inotify_fd != -1)
+    {
+        file.wd = inotify_add_watch(file.inotify_fd,
+                                    path,
+                                    IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+                                        IN_MOVE_SELF | IN_DELETE_SELF);
+    }
+
+    file.stale = (file.wd == -1);
+#else
+    (void)path;
+
+    file.stale = true;
+#endif
+}
+
+/* Return true for files generated on read, these report no changes */
+bool file_generated(int fd)
+{
+#ifdef __linux__
+    struct statfs sfs;
 
-    for (s = buffer; *s; s++)
+    if (fstatfs(fd, &sfs) == -1)
     {
-        if (*s != '\t')
+        return true;
+    }
+
+    switch (sfs.f_type)
+    {
+        case PROC_SUPER_MAGIC:
+        case SYSFS_MAGIC:
+        case DEBUGFS_MAGIC:
+        case TRACEFS_MAGIC:
+        case SECURITYFS_MAGIC:
+        case CGROUP_SUPER_MAGIC:
+        case CGROUP2_SUPER_MAGIC:
         {
-            tmp++;
+            return true;
         }
-        else
+        default:
         {
-            tmp += TABSIZE - (tmp % TABSIZE);
+            return false;
         }
+    }
+#else
+    (void)fd;
+
+    return true;
+#endif
+}
+
+bool file_changed()
+{
+#ifdef __linux__
+    union
+    {
+        struct inotify_event event;
+        char                 buffer[4096];
+    } events;
+    ssize_t len;
+#endif
 
-        if (*s == '\n')
+    if (file.stale)
+    {
+        return true;
+    }
+
+#ifdef __linux__
+    while ((len = read(file.inotify_fd, &events, sizeof(events))) > 0)
+    {
+        const struct inotify_event * event;
+        const char *                 s;
+
+        for (s = events.buffer; s < events.buffer + len;
+             s += sizeof(*event) + event->len)
         {
-            if (cols < tmp)
+            event = (const struct inotify_event *)s;
+
+            if (event->wd != file.wd)
             {
-                cols = tmp;
+                continue;
             }
 
-            tmp = 0;
+            file.stale = true;
 
-            lines++;
+            /* File was replaced or removed, watch its path again */
+            if (event->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED))
+            {
+                inotify_rm_watch(file.inotify_fd, file.wd);
+
+                file.wd = -1;
+            }
         }
     }
+#endif
 
-    if (cols < tmp)
-    {
-        cols = tmp;
-    }
+    return file.stale;
+}
 
-    /* Create pad */
-    if (!(pad = newpad(lines, cols)))
+char * file_to_buffer(const char * path, size_t * size)
+{
+    char *           buffer;
+    struct stat      st;
+    struct sigaction sa;
+    struct sigaction old_sa;
+    int              fd;
+
+    if (!(buffer = (char *)malloc(global.buffer_size + ELIDE_MARKER_SIZE)))
     {
-        exit_failed(1, "Failed to allocate pad workspace");
+        return NULL;
     }
 
-    /* Render text */
-    s    = buffer;
-    prev = buffer;
+    *size = 0;
 
-    for (i = 0; i < lines; i++)
+    if ((fd = open(path, O_RDONLY)) == -1 || fstat(fd, &st) == -1)
     {
-        while (*s && *s != '\n') s++;
+        snprintf(buffer,
+                 global.buffer_size,
+                 "\n\n\t\tCANNOT READ FILE: %s",
+                 strerror(errno));
 
-        wmove(pad, i, 0);
+        *size = strlen(buffer);
 
-        waddnstr(pad, prev, (int)(s - prev));
+        if (fd != -1)
+        {
+            close(fd);
+        }
 
-        prev = ++s;
-    }
+        file.stale = true;
 
-    if (cols_count)
-    {
-        *cols_count = cols;
+        return buffer;
     }
 
-    if (lines_count)
+    if (S_ISREG(st.st_mode) && st.st_size > 0)
     {
-        *lines_count = lines;
-    }
+        void *          map;
+        volatile size_t map_size; /* Read after siglongjmp() */
 
-    return pad;
-}
+        /* Watch before reading so no change goes unnoticed */
+        file_watch(path);
 
-/*******************************************************************************
-Run command and create pad from results
-*******************************************************************************/
-WINDOW * newpad_cmd(char * cmd)
-{
-    WINDOW * pad;
-    char *   buffer;
+        *size = (size_t)st.st_size;
 
-    if (!(buffer = cmd_to_buffer(cmd)))
-    {
-        exit_failed(1, "Failed to allocate command output buffer");
-    }
+        /* Map all of it when the end is kept, only what fits otherwise */
+        if (*size > global.buffer_size - 1 && !global.keep_tail)
+        {
+            *size = global.buffer_size - 1;
+        }
 
-    pad = newpad_buffer(buffer, &global.cols, &global.lines);
+        map_size = *size;
 
-    global.lines_digits = count_int_chars(global.lines);
+        if ((map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0)) !=
+            MAP_FAILED)
+        {
+            /* File truncated while copying raises SIGBUS, keep what fits */
+            memset(&sa, 0, sizeof(sa));
 
-    global.display_cols =
-        global.cols + ((global.show_lineno) ? global.lines_digits + 1 : 0);
+            sa.sa_handler = &file_sigbus;
 
-    free(buffer);
+            sigaction(SIGBUS, &sa, &old_sa);
 
-    return pad;
-}
+            if (sigsetjmp(file_sigbus_env, 1) == 0)
+            {
+                if (map_size > global.buffer_size - 1)
+                {
+                    const char * start = (const char *)map;
+                    size_t       head  = global.buffer_size - 1 -
+                                         global.keep_tail;
+                    size_t       tail  = map_size - global.keep_tail;
+
+                    memcpy(buffer, start, head);
+
+                    *size = elide(buffer,
+                                  head,
+                                  &start[tail],
+                                  global.keep_tail,
+                                  tail - head,
+                                  count_newlines(&start[head], tail - head));
+                }
+                else
+                {
+                    memcpy(buffer, map, *size);
+                }
+            }
+            else
+            {
+                *size      = 0;
+                file.stale = true;
+            }
 
-/*******************************************************************************
-Show help popup
-*******************************************************************************/
+            sigaction(SIGBUS, &old_sa, NULL);
+
+            munmap(map, map_size);
+        }
+        else
+        {
+            *size = 0;
+        }
+    }
+    else
+    {
+        ssize_t retval;
+
+        /* Size is unknown or contents are generated on read */
+        file.stale = true;
+
+        /* Empty files are watched until they grow like any other file */
+        if (S_ISREG(st.st_mode) && !file_generated(fd))
+        {
+            file_watch(path);
+        }
+
+        while ((retval = pread(fd,
+                               &buffer[*size],
+                               global.buffer_size - *size - 1,
+                               *size)) > 0)
+        {
+            *size += retval;
+
+            if (*size == global.buffer_size - 1) break;
+        }
+
+        /* Grew since fstat(), map it next time */
+        if (*size)
+        {
+            file.stale = true;
+        }
+    }
+
+    buffer[*size] = '\0';
+
+    close(fd);
+
+    return buffer;
+}
+
+/*******************************************************************************
+Collect output from plugin without a child process
+*******************************************************************************/
+struct
+{
+    void *                   handle;
+    void *                   state;
+    char *                   arg;
+    gaze_plugin_collect_fn * collect;
+    gaze_plugin_close_fn *   close;
+} plugin = { NULL, NULL, NULL, NULL, NULL };
+
+void plugin_cleanup()
+{
+    plugin.close(plugin.state);
+
+    dlclose(plugin.handle);
+}
+
+void plugin_init()
+{
+    gaze_plugin_abi_fn *  abi;
+    gaze_plugin_init_fn * init;
+
+    if (!(plugin.handle = dlopen(global.plugin_path, RTLD_NOW | RTLD_LOCAL)))
+    {
+        exit_failed(2, "Failed to load plugin: %s", dlerror());
+    }
+
+    abi            = (gaze_plugin_abi_fn *)dlsym(plugin.handle,
+                                                 "gaze_plugin_abi");
+    init           = (gaze_plugin_init_fn *)dlsym(plugin.handle,
+                                                  "gaze_plugin_init");
+    plugin.collect = (gaze_plugin_collect_fn *)dlsym(plugin.handle,
+                                                     "gaze_plugin_collect");
+    plugin.close   = (gaze_plugin_close_fn *)dlsym(plugin.handle,
+                                                   "gaze_plugin_close");
+
+    if (!abi || !init || !plugin.collect || !plugin.close)
+    {
+        exit_failed(2, "Invalid plugin: '%s'", global.plugin_path);
+    }
+
+    if (abi() != GAZE_PLUGIN_ABI_VERSION)
+    {
+        exit_failed(2,
+                    "Plugin ABI version %d, expected %d",
+                    abi(),
+                    GAZE_PLUGIN_ABI_VERSION);
+    }
+
+    if (init(plugin.arg, &plugin.state) != 0)
+    {
+        exit_failed(1, "Plugin failed to initialize");
+    }
+
+    atexit(plugin_cleanup);
+}
+
+char * plugin_to_buffer(size_t * size)
+{
+    char * buffer;
+    long   collected;
+
+    if (!(buffer = (char *)malloc(global.buffer_size)))
+    {
+        return NULL;
+    }
+
+    collected = plugin.collect(plugin.state, buffer, global.buffer_size - 1);
+
+    if (collected < 0 || (size_t)collected > global.buffer_size - 1)
+    {
+        strncpy(buffer, "\n\n\t\tPLUGIN FAILED", global.buffer_size);
+
+        buffer[global.buffer_size - 1] = '\0';
+
+        *size = strlen(buffer);
+    }
+    else
+    {
+        *size = (size_t)collected;
+
+        buffer[*size] = '\0';
+    }
+
+    return buffer;
+}
+
+/*******************************************************************************
+Run command when watched paths change
+
+Events are collected with inotify and the command runs once they stop
+arriving for the debounce window, the interval still applies as a fallback.
+*******************************************************************************/
+struct
+{
+    const char **   paths;
+    int *           wds;
+    int             count;
+    int             inotify_fd;
+    int             debounce;
+    bool            pending;
+    struct timespec event_time;
+} on_change = { NULL, NULL, 0, -1, DEFAULT_DEBOUNCE, false, { 0, 0 } };
+
+void on_change_add(const char * path)
+{
+    const char ** paths;
+    int *         wds;
+
+    paths = (const char **)realloc(on_change.paths,
+                                   (on_change.count + 1) * sizeof(*paths));
+    wds   = (int *)realloc(on_change.wds, (on_change.count + 1) * sizeof(*wds));
+
+    if (!paths || !wds)
+    {
+        exit_failed(2, "malloc() failed");
+    }
+
+    paths[on_change.count] = path;
+    wds[on_change.count]   = -1;
+
+    on_change.paths = paths;
+    on_change.wds   = wds;
+    on_change.count++;
+}
+
+#ifdef __linux__
+bool on_change_watch(int i)
+{
+    on_change.wds[i] = inotify_add_watch(
+        on_change.inotify_fd,
+        on_change.paths[i],
+        IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE |
+            IN_MOVED_FROM | IN_MOVED_TO | IN_MOVE_SELF | IN_DELETE_SELF);
+
+    return on_change.wds[i] != -1;
+}
+#endif
+
+void on_change_init()
+{
+#ifdef __linux__
+    int i;
+
+    if ((on_change.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1)
+    {
+        exit_failed(1, "Error: inotify_init1(): %s", strerror(errno));
+    }
+
+    for (i = 0; i < on_change.count; i++)
+    {
+        if (!on_change_watch(i))
+        {
+            exit_failed(2,
+                        "Cannot watch '%s': %s",
+                        on_change.paths[i],
+                        strerror(errno));
+        }
+    }
+#else
+    exit_failed(2, "--on-change requires inotify");
+#endif
+}
+
+bool on_change_due()
+{
+#ifdef __linux__
+    union
+    {
+        struct inotify_event event;
+        char                 buffer[4096];
+    } events;
+    struct timespec now;
+    ssize_t         len;
+    uint64_t        elapsed;
+    int             i;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    while ((len = read(on_change.inotify_fd, &events, sizeof(events))) > 0)
+    {
+        const struct inotify_event * event;
+        const char *                 s;
+
+        for (s = events.buffer; s < events.buffer + len;
+             s += sizeof(*event) + event->len)
+        {
+            event = (const struct inotify_event *)s;
+
+            on_change.pending    = true;
+            on_change.event_time = now;
+
+            /* Path was replaced or removed, watch it again below */
+            if (event->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED))
+            {
+                for (i = 0; i < on_change.count; i++)
+                {
+                    if (on_change.wds[i] == event->wd)
+                    {
+                        inotify_rm_watch(on_change.inotify_fd, event->wd);
+
+                        on_change.wds[i] = -1;
+                    }
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < on_change.count; i++)
+    {
+        if (on_change.wds[i] == -1 && on_change_watch(i))
+        {
+            /* Path reappeared */
+            on_change.pending    = true;
+            on_change.event_time = now;
+        }
+    }
+
+    if (!on_change.pending)
+    {
+        return false;
+    }
+
+    /* Wait for events to settle */
+    elapsed  = (now.tv_sec - on_change.event_time.tv_sec);
+    elapsed *= UINT64_C(1000);
+    elapsed += (now.tv_nsec - on_change.event_time.tv_nsec) / 1000000;
+
+    return (int)elapsed >= on_change.debounce;
+#else
+    return false;
+#endif
+}
+
+/*******************************************************************************
+Hash bytes (FNV-1a)
+*******************************************************************************/
+#define HASH_SEED (UINT64_C(14695981039346656037))
+
+uint64_t hash_update(uint64_t hash, const char * s, size_t len)
+{
+    while (len--)
+    {
+        hash ^= (unsigned char)*s++;
+        hash *= UINT64_C(1099511628211);
+    }
+
+    return hash;
+}
+
+uint64_t hash_bytes(const char * s, size_t len)
+{
+    return hash_update(HASH_SEED, s, len);
+}
+
+/*******************************************************************************
+Growable text buffer, always NUL terminated
+*******************************************************************************/
+struct text
+{
+    char * data;
+    size_t size;
+    size_t capacity;
+};
+
+void text_init(struct text * text, size_t capacity)
+{
+    if (!(text->data = (char *)malloc(capacity)))
+    {
+        exit_failed(1, "Failed to allocate text buffer");
+    }
+
+    text->data[0]  = '\0';
+    text->size     = 0;
+    text->capacity = capacity;
+}
+
+void text_append(struct text * text, const char * s, size_t len)
+{
+    if (text->size + len + 1 > text->capacity)
+    {
+        char * data;
+
+        while (text->size + len + 1 > text->capacity)
+        {
+            text->capacity *= 2;
+        }
+
+        if (!(data = (char *)realloc(text->data, text->capacity)))
+        {
+            exit_failed(1, "Failed to allocate text buffer");
+        }
+
+        text->data = data;
+    }
+
+    memcpy(&text->data[text->size], s, len);
+
+    text->size             += len;
+    text->data[text->size]  = '\0';
+}
+
+/* Return length of line at s, up to the newline or the end of the text */
+size_t line_length(const char * s, const char * end)
+{
+    const char * newline = (const char *)memchr(s, '\n', end - s);
+
+    return (newline) ? (size_t)(newline - s) : (size_t)(end - s);
+}
+
+/* Count lines, text ending with a newline has an empty last line */
+int line_count(const char * s, size_t size)
+{
+    const char * end = s + size;
+    int          count;
+
+    for (count = 1; (s = (const char *)memchr(s, '\n', end - s)); s++)
+    {
+        count++;
+    }
+
+    return count;
+}
+
+/* Record offset and hash of every line */
+void line_index(const char * buffer,
+                size_t       size,
+                int          lines,
+                size_t *     offsets,
+                uint64_t *   hashes)
+{
+    const char * end = buffer + size;
+    const char * s;
+    int          i;
+
+    for (s = buffer, i = 0; i < lines; i++)
+    {
+        size_t len = line_length(s, end);
+
+        offsets[i] = s - buffer;
+        hashes[i]  = hash_bytes(s, len);
+
+        s += len + 1;
+    }
+}
+
+/* Count lines matching at the start and at the end of two line indexes */
+void line_match(const uint64_t * hashes,
+                int              lines,
+                const uint64_t * old_hashes,
+                int              old_lines,
+                int *            prefix,
+                int *            suffix)
+{
+    for (*prefix = 0; *prefix < lines && *prefix < old_lines &&
+                      hashes[*prefix] == old_hashes[*prefix];
+         (*prefix)++) { }
+
+    for (*suffix = 0;
+         *suffix < lines - *prefix && *suffix < old_lines - *prefix &&
+         hashes[lines - *suffix - 1] == old_hashes[old_lines - *suffix - 1];
+         (*suffix)++) { }
+}
+
+/*******************************************************************************
+Limit terminal output in low bandwidth mode
+
+Frames are drawn at most max_fps times per second and only when a visible
+row changed, snapshot and scroll updates in between are coalesced. Bytes
+written by doupdate() are measured with the wchar counter in /proc/self/io.
+*******************************************************************************/
+struct
+{
+    bool            enabled;
+    int             max_fps;
+    struct timespec frame_time;
+    time_t          change_time;
+    int             io_fd;
+    uint64_t        bytes;
+    uint64_t        frames;
+} lowbw = {
+    false, DEFAULT_MAX_FPS, { 0, 0 }, 0, -1, 0, 0
+};
+
+uint64_t lowbw_wchar()
+{
+    char         buffer[512];
+    const char * s;
+    ssize_t      len;
+
+    if ((len = pread(lowbw.io_fd, buffer, sizeof(buffer) - 1, 0)) <= 0)
+    {
+        return 0;
+    }
+
+    buffer[len] = '\0';
+
+    if (!(s = strstr(buffer, "wchar:")))
+    {
+        return 0;
+    }
+
+    return strtoull(s + 6, NULL, 10);
+}
+
+void lowbw_report()
+{
+    if (lowbw.io_fd == -1)
+    {
+        printf("gaze: %" PRIu64 " frames, byte count unavailable\n",
+               lowbw.frames);
+
+        return;
+    }
+
+    printf("gaze: %" PRIu64 " bytes written to terminal in %" PRIu64
+           " frames\n",
+           lowbw.bytes,
+           lowbw.frames);
+}
+
+void lowbw_init()
+{
+    lowbw.io_fd = open("/proc/self/io", O_RDONLY);
+
+    if (lowbw.io_fd != -1)
+    {
+        fcntl(lowbw.io_fd, F_SETFD, FD_CLOEXEC);
+    }
+
+    atexit(lowbw_report);
+}
+
+bool lowbw_frame_due()
+{
+    struct timespec now;
+    uint64_t        elapsed;
+
+    if (!lowbw.enabled)
+    {
+        return true;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    elapsed  = (now.tv_sec - lowbw.frame_time.tv_sec);
+    elapsed *= UINT64_C(1000);
+    elapsed += (now.tv_nsec - lowbw.frame_time.tv_nsec) / 1000000;
+
+    if ((int)elapsed < 1000 / lowbw.max_fps)
+    {
+        return false;
+    }
+
+    lowbw.frame_time = now;
+
+    return true;
+}
+
+void lowbw_doupdate()
+{
+    uint64_t before;
+
+    if (!lowbw.enabled || lowbw.io_fd == -1)
+    {
+        doupdate();
+
+        lowbw.frames++;
+
+        return;
+    }
+
+    before = lowbw_wchar();
+
+    doupdate();
+
+    lowbw.bytes += lowbw_wchar() - before;
+    lowbw.frames++;
+}
+
+/*******************************************************************************
+Count characters required to print int
+*******************************************************************************/
+int count_int_chars(int n)
+{
+    int digits = (n < 0) ? 2 : 1;
+
+    while ((n /= 10)) digits++;
+
+    return digits;
+}
+
+/*******************************************************************************
+Escape bytes that are not printable text
+
+Control bytes are shown as ^X and bytes that are not part of valid UTF-8 as
+\xNN, both highlighted so they stand apart from the same text in the output.
+*******************************************************************************/
+/* Return length of valid UTF-8 sequence at s, 0 if there is none */
+int utf8_length(const char * s, const char * end)
+{
+    const unsigned char * u = (const unsigned char *)s;
+    uint32_t              code_point;
+    uint32_t              min;
+    int                   len;
+    int                   i;
+
+    if (u[0] < 0x80)
+    {
+        return 1;
+    }
+    else if ((u[0] & 0xe0) == 0xc0)
+    {
+        len        = 2;
+        code_point = u[0] & 0x1f;
+        min        = 0xa0; /* C1 control characters are escaped too */
+    }
+    else if ((u[0] & 0xf0) == 0xe0)
+    {
+        len        = 3;
+        code_point = u[0] & 0x0f;
+        min        = 0x800;
+    }
+    else if ((u[0] & 0xf8) == 0xf0)
+    {
+        len        = 4;
+        code_point = u[0] & 0x07;
+        min        = 0x10000;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (end - s < len)
+    {
+        return 0;
+    }
+
+    for (i = 1; i < len; i++)
+    {
+        if ((u[i] & 0xc0) != 0x80)
+        {
+            return 0;
+        }
+
+        code_point = (code_point << 6) | (u[i] & 0x3f);
+    }
+
+    /* Overlong encodings, surrogates and code points beyond Unicode */
+    if (code_point < min || (code_point >= 0xd800 && code_point <= 0xdfff) ||
+        code_point > 0x10ffff)
+    {
+        return 0;
+    }
+
+    return len;
+}
+
+
+/* Return code point of glyph of n bytes at s */
+wchar_t glyph_code_point(const char * s, int n)
+{
+    const unsigned char * u = (const unsigned char *)s;
+    uint32_t              code_point;
+    int                   i;
+
+    if (n == 1)
+    {
+        return (wchar_t)u[0];
+    }
+
+    code_point = u[0] & (0xff >> (n + 1));
+
+    for (i = 1; i < n; i++)
+    {
+        code_point = (code_point << 6) | (u[i] & 0x3f);
+    }
+
+    return (wchar_t)code_point;
+}
+
+/* Return number of bytes at s shown as they are, 0 if *s is escaped */
+int glyph_length(const char * s, const char * end)
+{
+    unsigned char c = (unsigned char)*s;
+    int           n;
+
+    if (c == '\t' || (c >= 0x20 && c < 0x7f))
+    {
+        return 1;
+    }
+    else if (c < 0x20 || c == 0x7f)
+    {
+        return 0;
+    }
+
+    /* Code points without a width are not printable, escape them too */
+    if ((n = utf8_length(s, end)) && wcwidth(glyph_code_point(s, n)) < 0)
+    {
+        return 0;
+    }
+
+    return n;
+}
+
+/* Return columns used by glyph of n bytes at s, as counted by curses */
+int glyph_width(const char * s, int n)
+{
+    return (n == 1) ? 1 : wcwidth(glyph_code_point(s, n));
+}
+
+/* Format escaped glyph of byte c, return its width */
+int glyph_escape(char c, char * escape)
+{
+    unsigned char u = (unsigned char)c;
+
+    if (u < 0x20 || u == 0x7f)
+    {
+        escape[0] = '^';
+        escape[1] = (char)(u ^ 0x40);
+        escape[2] = '\0';
+
+        return 2;
+    }
+
+    snprintf(escape, 5, "\\x%02X", u);
+
+    return 4;
+}
+
+/* Return length of line at s without the carriage return of a CRLF */
+int glyph_line_length(const char * s, const char * end)
+{
+    int len = (int)line_length(s, end);
+
+    if (len && s[len - 1] == '\r' && s + len < end)
+    {
+        len--;
+    }
+
+    return len;
+}
+
+/* Return number of columns used to show line */
+int glyph_line_width(const char * line, int len)
+{
+    const char * s   = line;
+    const char * end = line + len;
+    int          cols;
+
+    for (cols = 0; s < end;)
+    {
+        char escape[5];
+        int  n;
+
+        if (*s == '\t')
+        {
+            cols += TABSIZE - (cols % TABSIZE);
+            s++;
+        }
+        else if ((n = glyph_length(s, end)))
+        {
+            cols += glyph_width(s, n);
+            s    += n;
+        }
+        else
+        {
+            cols += glyph_escape(*s++, escape);
+        }
+    }
+
+    return cols;
+}
+
+/* Add line to pad, text between escaped glyphs is added in wide runs */
+void glyph_line_add(WINDOW * pad, const char * line, int len)
+{
+    const char * s   = line;
+    const char * end = line + len;
+    wchar_t      run[256];
+    int          count = 0;
+
+    while (s < end)
+    {
+        char escape[5];
+        int  n;
+
+        if ((n = glyph_length(s, end)))
+        {
+            run[count++]  = glyph_code_point(s, n);
+            s            += n;
+
+            if (count == (int)(sizeof(run) / sizeof(*run)))
+            {
+                waddnwstr(pad, run, count);
+
+                count = 0;
+            }
+
+            continue;
+        }
+
+        if (count)
+        {
+            waddnwstr(pad, run, count);
+
+            count = 0;
+        }
+
+        glyph_escape(*s++, escape);
+
+        wattron(pad, A_STANDOUT);
+        waddstr(pad, escape);
+        wattroff(pad, A_STANDOUT);
+    }
+
+    if (count)
+    {
+        waddnwstr(pad, run, count);
+    }
+}
+
+/*******************************************************************************
+Create pad from buffer
+*******************************************************************************/
+WINDOW * newpad_buffer(const char * buffer,
+                       size_t       size,
+                       int *        cols_count,
+                       int *        lines_count)
+{
+    WINDOW *     pad;
+    const char * end;
+    const char * s;
+    int          lines;
+    int          cols;
+    int          i;
+
+    /* Calculate number of lines and columns in buffer */
+    end   = buffer + size;
+    lines = line_count(buffer, size);
+    cols  = 1;
+
+    for (s = buffer, i = 0; i < lines; i++)
+    {
+        int len   = glyph_line_length(s, end);
+        int width = glyph_line_width(s, len);
+
+        if (cols < width)
+        {
+            cols = width;
+        }
+
+        s += line_length(s, end) + 1;
+    }
+
+    /* Create pad */
+    if (!(pad = newpad(lines, cols)))
+    {
+        exit_failed(1, "Failed to allocate pad workspace");
+    }
+
+    /* Render text */
+    for (s = buffer, i = 0; i < lines; i++)
+    {
+        wmove(pad, i, 0);
+
+        glyph_line_add(pad, s, glyph_line_length(s, end));
+
+        s += line_length(s, end) + 1;
+    }
+
+    if (cols_count)
+    {
+        *cols_count = cols;
+    }
+
+    if (lines_count)
+    {
+        *lines_count = lines;
+    }
+
+    return pad;
+}
+
+/*******************************************************************************
+Highlight patterns
+
+All patterns are compiled into one Aho-Corasick automaton, a table of 256
+transitions per state, so each visible line is matched against every
+pattern in a single pass. Attributes are applied to the pad when a row is
+first drawn after it was rendered and stay there until the row changes.
+
+A rules file holds one pattern per line. Attributes may precede the pattern
+separated by a tab, e.g. "bold,red<TAB>ERROR". Empty lines and lines
+starting with '#' are ignored.
+*******************************************************************************/
+struct highlight_rule
+{
+    char * pattern;
+    int    len;
+    attr_t attr;
+    short  pair;
+};
+
+struct
+{
+    struct highlight_rule * rules;
+    int                     rule_count;
+    int *                   next;   /* 256 transitions per state */
+    int *                   fail;
+    int *                   output; /* Rule of pattern ending in state or -1 */
+    int *                   dict;   /* Next state on fail path with output */
+    int                     states;
+    int *                   columns;
+    int                     column_capacity;
+} highlight = { NULL, 0, NULL, NULL, NULL, NULL, 0, NULL, 0 };
+
+const struct
+{
+    const char * name;
+    attr_t       attr;
+    short        color;
+} HIGHLIGHT_ATTRS[] = {
+    { "bold", A_BOLD, -1 },
+    { "dim", A_DIM, -1 },
+    { "reverse", A_REVERSE, -1 },
+    { "standout", A_STANDOUT, -1 },
+    { "underline", A_UNDERLINE, -1 },
+    { "red", A_NORMAL, COLOR_RED },
+    { "green", A_NORMAL, COLOR_GREEN },
+    { "yellow", A_NORMAL, COLOR_YELLOW },
+    { "blue", A_NORMAL, COLOR_BLUE },
+    { "magenta", A_NORMAL, COLOR_MAGENTA },
+    { "cyan", A_NORMAL, COLOR_CYAN }
+};
+
+void highlight_add(const char * pattern, int len, attr_t attr, short pair)
+{
+    struct highlight_rule * rules;
+    struct highlight_rule * rule;
+
+    if (len == 0)
+    {
+        exit_failed(2, "Empty highlight pattern");
+    }
+
+    if (!(rules = (struct highlight_rule *)realloc(
+              highlight.rules,
+              (highlight.rule_count + 1) * sizeof(*rules))))
+    {
+        exit_failed(2, "malloc() failed");
+    }
+
+    highlight.rules = rules;
+
+    rule = &highlight.rules[highlight.rule_count++];
+
+    if (!(rule->pattern = strndup(pattern, len)))
+    {
+        exit_failed(2, "malloc() failed");
+    }
+
+    rule->len  = len;
+    rule->attr = attr;
+    rule->pair = pair;
+}
+
+/* Parse comma separated attributes, colors use the pair of the same number */
+void highlight_parse_attrs(const char * s, int len, attr_t * attr, short * pair)
+{
+    const char * end = s + len;
+
+    *attr = A_NORMAL;
+    *pair = 0;
+
+    while (s < end)
+    {
+        const char * comma = (const char *)memchr(s, ',', end - s);
+        int          n     = (int)((comma ? comma : end) - s);
+        size_t       i;
+
+        for (i = 0; i < sizeof(HIGHLIGHT_ATTRS) / sizeof(*HIGHLIGHT_ATTRS);
+             i++)
+        {
+            if ((int)strlen(HIGHLIGHT_ATTRS[i].name) == n &&
+                !strncmp(HIGHLIGHT_ATTRS[i].name, s, n))
+            {
+                break;
+            }
+        }
+
+        if (i == sizeof(HIGHLIGHT_ATTRS) / sizeof(*HIGHLIGHT_ATTRS))
+        {
+            exit_failed(2, "Invalid highlight attribute: '%.*s'", n, s);
+        }
+
+        *attr |= HIGHLIGHT_ATTRS[i].attr;
+
+        if (HIGHLIGHT_ATTRS[i].color != -1)
+        {
+            *pair = HIGHLIGHT_ATTRS[i].color;
+        }
+
+        s += n + (comma ? 1 : 0);
+    }
+}
+
+void highlight_load(const char * path)
+{
+    FILE *  fp;
+    char *  line;
+    size_t  capacity;
+    ssize_t len;
+
+    if (!(fp = fopen(path, "r")))
+    {
+        exit_failed(2, "Cannot read '%s': %s", path, strerror(errno));
+    }
+
+    line     = NULL;
+    capacity = 0;
+
+    while ((len = getline(&line, &capacity, fp)) != -1)
+    {
+        const char * tab;
+        attr_t       attr;
+        short        pair;
+
+        while (len && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+        {
+            len--;
+        }
+
+        if (len == 0 || line[0] == '#')
+        {
+            continue;
+        }
+
+        if ((tab = (const char *)memchr(line, '\t', len)))
+        {
+            highlight_parse_attrs(line, (int)(tab - line), &attr, &pair);
+
+            highlight_add(tab + 1, (int)(len - (tab + 1 - line)), attr, pair);
+        }
+        else
+        {
+            highlight_add(line, (int)len, A_REVERSE, 0);
+        }
+    }
+
+    free(line);
+
+    fclose(fp);
+}
+
+/* Build automaton, called once all patterns are known */
+void highlight_init()
+{
+    int * queue;
+    int   head;
+    int   tail;
+    int   max_states;
+    int   i;
+    int   c;
+
+    /* Colors are optional, attributes alone still work without them */
+    if (has_colors())
+    {
+        start_color();
+        use_default_colors();
+
+        for (i = 1; i < 8; i++)
+        {
+            init_pair(i, i, -1);
+        }
+    }
+
+    for (max_states = 1, i = 0; i < highlight.rule_count; i++)
+    {
+        max_states += highlight.rules[i].len;
+    }
+
+    highlight.next   = (int *)malloc((size_t)max_states * 256 * sizeof(int));
+    highlight.fail   = (int *)malloc(max_states * sizeof(int));
+    highlight.output = (int *)malloc(max_states * sizeof(int));
+    highlight.dict   = (int *)malloc(max_states * sizeof(int));
+    queue            = (int *)malloc(max_states * sizeof(int));
+
+    if (!highlight.next || !highlight.fail || !highlight.output ||
+        !highlight.dict || !queue)
+    {
+        exit_failed(1, "Failed to allocate highlight automaton");
+    }
+
+    /* Trie of all patterns */
+    memset(highlight.next, -1, (size_t)max_states * 256 * sizeof(int));
+
+    highlight.states    = 1;
+    highlight.output[0] = -1;
+
+    for (i = 0; i < highlight.rule_count; i++)
+    {
+        const struct highlight_rule * rule  = &highlight.rules[i];
+        int                           state = 0;
+        int                           j;
+
+        for (j = 0; j < rule->len; j++)
+        {
+            int * next = &highlight.next[state * 256 +
+                                         (unsigned char)rule->pattern[j]];
+
+            if (*next == -1)
+            {
+                highlight.output[highlight.states] = -1;
+
+                *next = highlight.states++;
+            }
+
+            state = *next;
+        }
+
+        /* Later rules for the same pattern take precedence */
+        highlight.output[state] = i;
+    }
+
+    /* Fail links breadth first, missing transitions follow them */
+    head = 0;
+    tail = 0;
+
+    highlight.fail[0] = 0;
+    highlight.dict[0] = 0;
+
+    for (c = 0; c < 256; c++)
+    {
+        int * next = &highlight.next[c];
+
+        if (*next == -1)
+        {
+            *next = 0;
+        }
+        else
+        {
+            highlight.fail[*next] = 0;
+            highlight.dict[*next] = 0;
+            queue[tail++]         = *next;
+        }
+    }
+
+    while (head < tail)
+    {
+        int state = queue[head++];
+
+        for (c = 0; c < 256; c++)
+        {
+            int * next = &highlight.next[state * 256 + c];
+            int   fail = highlight.next[highlight.fail[state] * 256 + c];
+
+            if (*next == -1)
+            {
+                *next = fail;
+
+                continue;
+            }
+
+            highlight.fail[*next] = fail;
+            highlight.dict[*next] =
+                (highlight.output[fail] != -1) ? fail : highlight.dict[fail];
+            queue[tail++] = *next;
+        }
+    }
+
+    free(queue);
+}
+
+/* Match line and apply attributes to its row in pad */
+void highlight_row(WINDOW * pad, int row, const char * line, int len)
+{
+    const char * end = line + len;
+    const char * s;
+    int          state;
+    int          col;
+    int          i;
+
+    if (len + 1 > highlight.column_capacity)
+    {
+        int * columns;
+
+        if (!(columns = (int *)realloc(highlight.columns,
+                                       (len + 1) * sizeof(*columns))))
+        {
+            exit_failed(1, "Failed to allocate highlight workspace");
+        }
+
+        highlight.columns         = columns;
+        highlight.column_capacity = len + 1;
+    }
+
+    /* Column of every byte as rendered by glyph_line_add() */
+    for (s = line, col = 0; s < end;)
+    {
+        char escape[5];
+        int  n;
+
+        highlight.columns[s - line] = col;
+
+        if (*s == '\t')
+        {
+            col += TABSIZE - (col % TABSIZE);
+            s++;
+        }
+        else if ((n = glyph_length(s, end)))
+        {
+            for (i = 1; i < n; i++)
+            {
+                highlight.columns[s - line + i] = col;
+            }
+
+            col += glyph_width(s, n);
+            s   += n;
+        }
+        else
+        {
+            col += glyph_escape(*s++, escape);
+        }
+    }
+
+    highlight.columns[len] = col;
+
+    for (state = 0, i = 0; i < len; i++)
+    {
+        int match;
+
+        state = highlight.next[state * 256 + (unsigned char)line[i]];
+
+        for (match = (highlight.output[state] != -1) ? state :
+                                                       highlight.dict[state];
+             match;
+             match = highlight.dict[match])
+        {
+            const struct highlight_rule * rule =
+                &highlight.rules[highlight.output[match]];
+            int start = highlight.columns[i + 1 - rule->len];
+
+            mvwchgat(pad,
+                     row,
+                     start,
+                     highlight.columns[i + 1] - start,
+                     rule->attr,
+                     rule->pair,
+                     NULL);
+        }
+    }
+}
+
+/*******************************************************************************
+Memory threshold and pressure
+
+Once a second the resident size is compared with the --memory-high threshold
+and the share of time stalled on memory is read from /proc/pressure/memory.
+Like memory.high of cgroups this is no hard limit: the pad holds every cell
+of the output and is never given up. While above the threshold or under
+pressure, the interval is stretched and state that is only kept to save work
+is shed: the text and line hashes kept with the pad and the table sort keys.
+When shedding does not bring the resident size below the threshold that
+state is kept again, it is not what uses the memory. All of it is built
+again with the first snapshot once memory is fine.
+*******************************************************************************/
+struct
+{
+    size_t high;
+    bool   pressure;
+    bool   above;
+    bool   futile;   /* Shedding left the resident size above high */
+    bool   shedding;
+    time_t check_time;
+} memory = { 0, false, false, false, false, 0 };
+
+size_t memory_resident()
+{
+    unsigned long pages = 0;
+    FILE *        f;
+
+    if (!(f = fopen("/proc/self/statm", "r")))
+    {
+        return 0;
+    }
+
+    if (fscanf(f, "%*u %lu", &pages) != 1)
+    {
+        pages = 0;
+    }
+
+    fclose(f);
+
+    return pages * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+/* Return percent of time some tasks stalled on memory, 0 without PSI */
+double memory_stalled()
+{
+    double avg10 = 0;
+    FILE * f;
+
+    if (!(f = fopen("/proc/pressure/memory", "r")))
+    {
+        return 0;
+    }
+
+    if (fscanf(f, "some avg10=%lf", &avg10) != 1)
+    {
+        avg10 = 0;
+    }
+
+    fclose(f);
+
+    return avg10;
+}
+
+/* Update pressure and budget once a second, return true if to shed */
+bool memory_check()
+{
+    time_t now = time(NULL);
+    double stalled;
+
+    if (now == memory.check_time)
+    {
+        return false;
+    }
+
+    memory.check_time = now;
+
+    /* Pressure ends only once stalls fall to half the threshold */
+    stalled = memory_stalled();
+
+    if (stalled >= MEMORY_PRESSURE)
+    {
+        memory.pressure = true;
+    }
+    else if (stalled < MEMORY_PRESSURE / 2.0)
+    {
+        memory.pressure = false;
+    }
+
+    memory.above = memory.high && memory_resident() > memory.high;
+
+    if (!memory.above)
+    {
+        memory.futile = false;
+    }
+
+    memory.shedding = memory.pressure || (memory.above && !memory.futile);
+
+    return memory.shedding;
+}
+
+/* Stop shedding for the threshold if it did not help, until back below */
+void memory_shed_done()
+{
+    if (memory.above && !memory.pressure)
+    {
+        memory.futile   = memory_resident() > memory.high;
+        memory.shedding = !memory.futile;
+    }
+}
+
+int memory_interval(int interval)
+{
+    return (memory.pressure || memory.above) ?
+               interval * MEMORY_PRESSURE_STRETCH :
+               interval;
+}
+
+/* Return freed memory to the system */
+void memory_trim()
+{
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+}
+
+/*******************************************************************************
+Patch persistent pad with changed lines
+
+The displayed text is kept in one pad for the whole session. Each snapshot
+is hashed line by line and compared with the previous one: lines matching
+at the start and at the end are kept, rows in between are shifted with
+winsdelln() when the line count changed and only the rest is rendered again.
+The text is kept to decorate rows when they are drawn. While memory is shed
+only the pad is kept and the next snapshot is rendered in full.
+*******************************************************************************/
+struct
+{
+    WINDOW *   pad;
+    char *     text;
+    size_t     size;
+    size_t *   offsets;
+    uint64_t * hashes;
+    int *      widths;
+    bool *     decorated;
+    int        lines;
+    int        cols;
+    int        first_changed;
+    int        last_changed;
+} view = { NULL, NULL, 0, NULL, NULL, NULL, NULL, 0, 0, 0, -1 };
+
+/* Resize pad, true only if it has the size asked for */
+bool view_resize(int lines, int cols)
+{
+    return wresize(view.pad, lines, cols) != ERR &&
+           getmaxy(view.pad) == lines && getmaxx(view.pad) == cols;
+}
+
+WINDOW * view_patch(const char * buffer, size_t size)
+{
+    uint64_t *   hashes;
+    int *        widths;
+    bool *       decorated;
+    size_t *     offsets;
+    char *       text;
+    const char * end;
+    const char * s;
+    int          lines;
+    int          cols;
+    int          prefix;
+    int          suffix;
+    int          i;
+
+    end   = buffer + size;
+    lines = line_count(buffer, size);
+
+    hashes    = (uint64_t *)malloc(lines * sizeof(*hashes));
+    widths    = (int *)malloc(lines * sizeof(*widths));
+    decorated = (bool *)calloc(lines, sizeof(*decorated));
+    offsets   = (size_t *)malloc(lines * sizeof(*offsets));
+    text      = (char *)malloc(size + 1);
+
+    if (!hashes || !widths || !decorated || !offsets || !text)
+    {
+        exit_failed(1, "Failed to allocate line hashes");
+    }
+
+    memcpy(text, buffer, size);
+
+    text[size] = '\0';
+
+    line_index(buffer, size, lines, offsets, hashes);
+
+    /* Keep lines matching at the start and at the end */
+    line_match(hashes,
+               lines,
+               view.hashes,
+               (view.hashes) ? view.lines : 0,
+               &prefix,
+               &suffix);
+
+    for (i = 0; i < prefix; i++)
+    {
+        widths[i]    = view.widths[i];
+        decorated[i] = view.decorated[i];
+    }
+
+    for (i = 0; i < suffix; i++)
+    {
+        widths[lines - i - 1]    = view.widths[view.lines - i - 1];
+        decorated[lines - i - 1] = view.decorated[view.lines - i - 1];
+    }
+
+    /* Measure changed lines, the widest line sets the pad width */
+    for (s = buffer, i = 0; i < lines - suffix; i++)
+    {
+        if (i >= prefix)
+        {
+            widths[i] = glyph_line_width(s, glyph_line_length(s, end));
+        }
+
+        s += line_length(s, end) + 1;
+    }
+
+    for (cols = 1, i = 0; i < lines; i++)
+    {
+        if (cols < widths[i])
+        {
+            cols = widths[i];
+        }
+    }
+
+    /* Curses may keep pad sizes in a short, larger ones would wrap around */
+    if (lines > SHRT_MAX || cols > SHRT_MAX)
+    {
+        exit_failed(1, "Failed to allocate pad workspace");
+    }
+
+    /* Resize pad and move the kept lines at the end into place */
+    if (!view.pad)
+    {
+        if (!(view.pad = newpad(lines, cols)))
+        {
+            exit_failed(1, "Failed to allocate pad workspace");
+        }
+    }
+    else if (lines > view.lines)
+    {
+        if (!view_resize(lines, (cols > view.cols) ? cols : view.cols))
+        {
+            exit_failed(1, "Failed to allocate pad workspace");
+        }
+
+        wmove(view.pad, prefix, 0);
+        winsdelln(view.pad, lines - view.lines);
+    }
+    else if (lines < view.lines)
+    {
+        wmove(view.pad, prefix, 0);
+        winsdelln(view.pad, lines - view.lines);
+    }
+
+    if ((lines != getmaxy(view.pad) || cols != getmaxx(view.pad)) &&
+        !view_resize(lines, cols))
+    {
+        exit_failed(1, "Failed to allocate pad workspace");
+    }
+
+    /* Render changed lines */
+    for (s = buffer, i = 0; i < lines - suffix; i++)
+    {
+        if (i >= prefix)
+        {
+            wmove(view.pad, i, 0);
+            wclrtoeol(view.pad);
+
+            glyph_line_add(view.pad, s, glyph_line_length(s, end));
+        }
+
+        s += line_length(s, end) + 1;
+    }
+
+    /* Rows after a change in line count show different lines too */
+    view.first_changed = prefix;
+    view.last_changed  = (lines == view.lines) ? lines - suffix - 1 :
+                                                 lines - 1;
+
+    free(view.text);
+    free(view.offsets);
+    free(view.hashes);
+    free(view.widths);
+    free(view.decorated);
+
+    if (memory.shedding)
+    {
+        free(text);
+        free(offsets);
+        free(hashes);
+        free(widths);
+        free(decorated);
+
+        text      = NULL;
+        offsets   = NULL;
+        hashes    = NULL;
+        widths    = NULL;
+        decorated = NULL;
+    }
+
+    view.text      = text;
+    view.size      = size;
+    view.offsets   = offsets;
+    view.hashes    = hashes;
+    view.widths    = widths;
+    view.decorated = decorated;
+    view.lines     = lines;
+    view.cols      = cols;
+
+    global.lines = lines;
+    global.cols  = cols;
+
+    return view.pad;
+}
+
+/* Drop text and line hashes kept with the pad, return true if any */
+bool view_shed()
+{
+    if (!view.hashes)
+    {
+        return false;
+    }
+
+    free(view.text);
+    free(view.offsets);
+    free(view.hashes);
+    free(view.widths);
+    free(view.decorated);
+
+    view.text      = NULL;
+    view.offsets   = NULL;
+    view.hashes    = NULL;
+    view.widths    = NULL;
+    view.decorated = NULL;
+
+    return true;
+}
+
+bool view_visible_changed(int top, int rows)
+{
+    return view.first_changed <= view.last_changed &&
+           view.first_changed < top + rows && view.last_changed >= top;
+}
+
+/* Highlight visible rows that were rendered since they were last drawn */
+void view_decorate(int top, int rows)
+{
+    int i;
+
+    if (!highlight.rule_count || !view.text)
+    {
+        return;
+    }
+
+    for (i = top; i < top + rows && i < view.lines; i++)
+    {
+        const char * line = &view.text[view.offsets[i]];
+        const char * end  = &view.text[view.size];
+
+        if (view.decorated[i])
+        {
+            continue;
+        }
+
+        highlight_row(view.pad, i, line, glyph_line_length(line, end));
+
+        view.decorated[i] = true;
+    }
+}
+
+/*******************************************************************************
+Table mode
+
+The first row of each snapshot is pinned as a header and the remaining rows
+are split into whitespace separated columns once per snapshot, the last
+column takes the rest of the row. Sort keys are cached by row hash together
+with the row's rank in the previous sort: rows carried over from the previous
+snapshot are pre-ordered by that rank so the natural merge sort finishes in
+close to one pass. Large tables are sorted in parallel chunks.
+*******************************************************************************/
+struct table_row
+{
+    const char * line;
+    int          len;
+    uint64_t     hash;
+    int          rank;
+    double       number;
+    bool         numeric;
+};
+
+struct table_key
+{
+    uint64_t hash;
+    int      rank; /* -1 marks an empty slot */
+    double   number;
+    bool     numeric;
+};
+
+struct table_chunk
+{
+    int * order;
+    int * tmp;
+    int   count;
+};
+
+struct
+{
+    bool               enabled;
+    char *             source;
+    const char *       header;
+    int                header_len;
+    int                columns;
+    struct table_row * rows;
+    int                row_count;
+    int *              cells;
+    int *              order;
+    int                order_count;
+    int                sort_column;
+    bool               descending;
+    char               filter[256];
+    struct table_key * keys;
+    size_t             key_mask;
+    int                key_count;
+    int                key_column;
+    bool               key_descending;
+    WINDOW *           header_pad;
+} table = { false, NULL, NULL, 0, 1,  NULL, 0,     NULL, NULL, 0,
+            -1,    false, "", NULL, 0, 0, -1, false, NULL };
+
+bool parse_number(const char * s, int len, double * number)
+{
+    const char * end = s + len;
+    double       value;
+    double       scale;
+    bool         negative;
+    bool         digits;
+
+    value    = 0;
+    scale    = 1;
+    negative = false;
+    digits   = false;
+
+    if (s < end && (*s == '-' || *s == '+'))
+    {
+        negative = (*s++ == '-');
+    }
+
+    while (s < end && isdigit((unsigned char)*s))
+    {
+        value  = value * 10 + (*s++ - '0');
+        digits = true;
+    }
+
+    if (s < end && *s == '.')
+    {
+        for (s++; s < end && isdigit((unsigned char)*s); s++)
+        {
+            scale  /= 10;
+            value  += (*s - '0') * scale;
+            digits  = true;
+        }
+    }
+
+    if (!digits)
+    {
+        return false;
+    }
+
+    /* Accept a single unit suffix as printed by ps, df, free -h, etc. */
+    if (s < end)
+    {
+        switch (*s++)
+        {
+            case 't':
+            case 'T': value *= 1024; /* fall through */
+            case 'g':
+            case 'G': value *= 1024; /* fall through */
+            case 'm':
+            case 'M': value *= 1024; /* fall through */
+            case 'k':
+            case 'K': value *= 1024; /* fall through */
+            case '%': break;
+            default:
+            {
+                return false;
+            }
+        }
+    }
+
+    if (s != end)
+    {
+        return false;
+    }
+
+    *number = negative ? -value : value;
+
+    return true;
+}
+
+/* Store offset and length of every column of line in cells */
+void table_split(const char * line, int len, int * cells)
+{
+    int pos;
+    int c;
+
+    pos = 0;
+
+    for (c = 0; c < table.columns; c++)
+    {
+        int start;
+
+        while (pos < len && isspace((unsigned char)line[pos])) pos++;
+
+        start = pos;
+
+        if (c == table.columns - 1)
+        {
+            pos = len;
+        }
+        else
+        {
+            while (pos < len && !isspace((unsigned char)line[pos])) pos++;
+        }
+
+        cells[c * 2]     = start;
+        cells[c * 2 + 1] = pos - start;
+    }
+}
+
+const char * table_cell(int row, int column, int * len)
+{
+    const int * cells = &table.cells[(row * table.columns + column) * 2];
+
+    *len = cells[1];
+
+    return &table.rows[row].line[cells[0]];
+}
+
+int table_compare(int a, int b)
+{
+    const struct table_row * x = &table.rows[a];
+    const struct table_row * y = &table.rows[b];
+    int                      result;
+
+    if (x->numeric && y->numeric)
+    {
+        result = (x->number > y->number) - (x->number < y->number);
+    }
+    else if (x->numeric != y->numeric)
+    {
+        result = x->numeric ? -1 : 1; /* Numbers before text */
+    }
+    else
+    {
+        const char * x_cell;
+        const char * y_cell;
+        int          x_len;
+        int          y_len;
+
+        x_cell = table_cell(a, table.sort_column, &x_len);
+        y_cell = table_cell(b, table.sort_column, &y_len);
+
+        result = memcmp(x_cell, y_cell, (x_len < y_len) ? x_len : y_len);
+
+        if (!result)
+        {
+            result = (x_len > y_len) - (x_len < y_len);
+        }
+    }
+
+    return table.descending ? -result : result;
+}
+
+void table_merge(const int * src, int * dst, int lo, int mid, int hi)
+{
+    int i = lo;
+    int j = mid;
+    int k = lo;
+
+    while (i < mid && j < hi)
+    {
+        /* Take from the left run on ties to keep the sort stable */
+        dst[k++] = (table_compare(src[j], src[i]) < 0) ? src[j++] : src[i++];
+    }
+
+    while (i < mid) dst[k++] = src[i++];
+    while (j < hi) dst[k++] = src[j++];
+}
+
+/* Stable natural merge sort, linear when order is already sorted */
+void * table_sort_chunk(void * arg)
+{
+    struct table_chunk * chunk = (struct table_chunk *)arg;
+    int *                src   = chunk->order;
+    int *                dst   = chunk->tmp;
+    int                  runs;
+
+    do {
+        int lo = 0;
+
+        runs = 0;
+
+        while (lo < chunk->count)
+        {
+            int mid = lo + 1;
+            int hi;
+
+            /* Find two adjacent runs and merge them */
+            while (mid < chunk->count &&
+                   table_compare(src[mid - 1], src[mid]) <= 0)
+            {
+                mid++;
+            }
+
+            hi = (mid < chunk->count) ? mid + 1 : mid;
+
+            while (hi < chunk->count &&
+                   table_compare(src[hi - 1], src[hi]) <= 0)
+            {
+                hi++;
+            }
+
+            table_merge(src, dst, lo, mid, hi);
+
+            lo = hi;
+            runs++;
+        }
+
+        /* Swap buffers */
+        {
+            int * tmp = src;
+
+            src = dst;
+            dst = tmp;
+        }
+    } while (runs > 1);
+
+    if (src != chunk->order)
+    {
+        memcpy(chunk->order, src, chunk->count * sizeof(*src));
+    }
+
+    return NULL;
+}
+
+void table_sort_order(int * order, int * tmp, int count)
+{
+    struct table_chunk chunks[TABLE_MAX_THREADS];
+    pthread_t          threads[TABLE_MAX_THREADS];
+    int                bounds[TABLE_MAX_THREADS + 1];
+    int                chunk_count;
+    int                i;
+
+    chunk_count = 1;
+
+    if (count >= TABLE_PARALLEL_ROWS)
+    {
+        chunk_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+        if (chunk_count > TABLE_MAX_THREADS)
+        {
+            chunk_count = TABLE_MAX_THREADS;
+        }
+        else if (chunk_count < 1)
+        {
+            chunk_count = 1;
+        }
+    }
+
+    for (i = 0; i <= chunk_count; i++)
+    {
+        bounds[i] = (int)((int64_t)count * i / chunk_count);
+    }
+
+    for (i = 0; i < chunk_count; i++)
+    {
+        chunks[i].order = &order[bounds[i]];
+        chunks[i].tmp   = &tmp[bounds[i]];
+        chunks[i].count = bounds[i + 1] - bounds[i];
+    }
+
+    /* Sort chunks, the calling thread takes the first one */
+    for (i = 1; i < chunk_count; i++)
+    {
+        if (pthread_create(&threads[i], NULL, table_sort_chunk, &chunks[i]))
+        {
+            table_sort_chunk(&chunks[i]);
+
+            threads[i] = pthread_self();
+        }
+    }
+
+    table_sort_chunk(&chunks[0]);
+
+    for (i = 1; i < chunk_count; i++)
+    {
+        if (!pthread_equal(threads[i], pthread_self()))
+        {
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    /* Merge sorted chunks pairwise */
+    while (chunk_count > 1)
+    {
+        int merged = 0;
+
+        for (i = 0; i < chunk_count; i += 2)
+        {
+            if (i + 1 < chunk_count)
+            {
+                table_merge(
+                    order, tmp, bounds[i], bounds[i + 1], bounds[i + 2]);
+            }
+            else
+            {
+                memcpy(&tmp[bounds[i]],
+                       &order[bounds[i]],
+                       (bounds[i + 1] - bounds[i]) * sizeof(*order));
+            }
+
+            bounds[merged++] = bounds[i];
+        }
+
+        bounds[merged] = count;
+        chunk_count    = merged;
+
+        memcpy(order, tmp, count * sizeof(*order));
+    }
+}
+
+struct table_key * table_key_find(uint64_t hash)
+{
+    size_t i;
+
+    if (!table.keys)
+    {
+        return NULL;
+    }
+
+    for (i = hash & table.key_mask; table.keys[i].rank != -1;
+         i = (i + 1) & table.key_mask)
+    {
+        if (table.keys[i].hash == hash)
+        {
+            return &table.keys[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Remember keys and ranks of the current sort for the next snapshot */
+void table_key_store()
+{
+    size_t size;
+    int    i;
+
+    for (size = 16; size < (size_t)table.order_count * 2; size *= 2) { }
+
+    if (size != table.key_mask + 1 || !table.keys)
+    {
+        free(table.keys);
+
+        if (!(table.keys = (struct table_key *)malloc(size *
+                                                      sizeof(*table.keys))))
+        {
+            exit_failed(1, "Failed to allocate table keys");
+        }
+
+        table.key_mask = size - 1;
+    }
+
+    for (i = 0; i <= (int)table.key_mask; i++)
+    {
+        table.keys[i].rank = -1;
+    }
+
+    for (i = 0; i < table.order_count; i++)
+    {
+        const struct table_row * row = &table.rows[table.order[i]];
+        size_t                   j;
+
+        for (j = row->hash & table.key_mask; table.keys[j].rank != -1;
+             j = (j + 1) & table.key_mask)
+        {
+            if (table.keys[j].hash == row->hash)
+            {
+                break;
+            }
+        }
+
+        if (table.keys[j].rank == -1)
+        {
+            table.keys[j].hash    = row->hash;
+            table.keys[j].rank    = i;
+            table.keys[j].number  = row->number;
+            table.keys[j].numeric = row->numeric;
+        }
+    }
+
+    table.key_count      = table.order_count;
+    table.key_column     = table.sort_column;
+    table.key_descending = table.descending;
+}
+
+/* Drop sort keys kept for the next snapshot, return true if any */
+bool table_shed()
+{
+    if (!table.keys)
+    {
+        return false;
+    }
+
+    free(table.keys);
+
+    table.keys       = NULL;
+    table.key_mask   = 0;
+    table.key_column = -2; /* Matches no sort column */
+
+    return true;
+}
+
+bool table_contains(const char * s, int len, const char * needle)
+{
+    int needle_len = strlen(needle);
+    int i;
+
+    for (i = 0; i + needle_len <= len; i++)
+    {
+        if (memcmp(&s[i], needle, needle_len) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Filter and sort rows into table.order */
+void table_sort()
+{
+    int * tmp;
+    int * counts;
+    bool  cached;
+    int   i;
+
+    /* Apply filter to sort column, or whole row when unsorted */
+    table.order_count = 0;
+
+    for (i = 0; i < table.row_count; i++)
+    {
+        if (table.filter[0])
+        {
+            const char * s;
+            int          len;
+
+            if (table.sort_column == -1)
+            {
+                s   = table.rows[i].line;
+                len = table.rows[i].len;
+            }
+            else
+            {
+                s = table_cell(i, table.sort_column, &len);
+            }
+
+            if (!table_contains(s, len, table.filter))
+            {
+                continue;
+            }
+        }
+
+        table.order[table.order_count++] = i;
+    }
+
+    if (table.sort_column == -1 || table.order_count < 2)
+    {
+        return;
+    }
+
+    /* Look up cached keys and previous ranks, parse the rest */
+    cached = (table.key_column == table.sort_column &&
+              table.key_descending == table.descending);
+
+    for (i = 0; i < table.order_count; i++)
+    {
+        struct table_row * row = &table.rows[table.order[i]];
+        struct table_key * key = cached ? table_key_find(row->hash) : NULL;
+
+        if (key)
+        {
+            row->rank    = key->rank;
+            row->number  = key->number;
+            row->numeric = key->numeric;
+        }
+        else
+        {
+            const char * cell;
+            int          len;
+
+            cell = table_cell(table.order[i], table.sort_column, &len);
+
+            row->rank    = cached ? table.key_count : 0;
+            row->numeric = parse_number(cell, len, &row->number);
+        }
+    }
+
+    if (!(tmp = (int *)malloc(table.order_count * sizeof(*tmp))))
+    {
+        exit_failed(1, "Failed to allocate table workspace");
+    }
+
+    /* Pre-order rows by previous rank (counting sort), new rows last */
+    if (cached)
+    {
+        if (!(counts = (int *)calloc(table.key_count + 2, sizeof(*counts))))
+        {
+            exit_failed(1, "Failed to allocate table workspace");
+        }
+
+        for (i = 0; i < table.order_count; i++)
+        {
+            counts[table.rows[table.order[i]].rank + 1]++;
+        }
+
+        for (i = 1; i <= table.key_count + 1; i++)
+        {
+            counts[i] += counts[i - 1];
+        }
+
+        for (i = 0; i < table.order_count; i++)
+        {
+            tmp[counts[table.rows[table.order[i]].rank]++] = table.order[i];
+        }
+
+        memcpy(table.order, tmp, table.order_count * sizeof(*tmp));
+
+        free(counts);
+    }
+
+    table_sort_order(table.order, tmp, table.order_count);
+
+    free(tmp);
+
+    /* Keys are kept for the next snapshot unless memory is shed */
+    if (memory.shedding)
+    {
+        table_shed();
+    }
+    else
+    {
+        table_key_store();
+    }
+}
+
+/* Parse snapshot into header and rows */
+void table_load(const char * buffer, size_t size)
+{
+    const char * s;
+    const char * end;
+    int          rows;
+    int          i;
+
+    free(table.source);
+
+    if (!(table.source = (char *)malloc(size + 1)))
+    {
+        exit_failed(1, "Failed to allocate table");
+    }
+
+    memcpy(table.source, buffer, size);
+
+    table.source[size] = '\0';
+
+    /* Header */
+    s                = table.source;
+    end              = table.source + size;
+    table.header     = s;
+    table.header_len = line_length(s, end);
+
+    s += table.header_len + ((s + table.header_len < end) ? 1 : 0);
+
+    /* Count rows, ignoring the empty line after a trailing newline */
+    rows = (s < end) ? line_count(s, end - s) - (end[-1] == '\n') : 0;
+
+    /* Columns are taken from the header */
+    table.columns = 0;
+
+    for (i = 0; i < table.header_len; i++)
+    {
+        if (!isspace((unsigned char)table.header[i]) &&
+            (i == 0 || isspace((unsigned char)table.header[i - 1])))
+        {
+            table.columns++;
+        }
+    }
+
+    if (table.columns < 1)
+    {
+        table.columns = 1;
+    }
+
+    if (table.sort_column >= table.columns)
+    {
+        table.sort_column = table.columns - 1;
+    }
+
+    /* Split rows */
+    free(table.rows);
+    free(table.cells);
+    free(table.order);
+
+    table.rows  = (struct table_row *)malloc((rows + 1) * sizeof(*table.rows));
+    table.cells = (int *)malloc((size_t)(rows + 1) * table.columns * 2 *
+                                sizeof(*table.cells));
+    table.order = (int *)malloc((rows + 1) * sizeof(*table.order));
+
+    if (!table.rows || !table.cells || !table.order)
+    {
+        exit_failed(1, "Failed to allocate table");
+    }
+
+    table.row_count = rows;
+
+    for (i = 0; i < rows; i++)
+    {
+        struct table_row * row = &table.rows[i];
+
+        row->line = s;
+        row->len  = line_length(s, end);
+        row->hash = hash_bytes(row->line, row->len);
+
+        table_split(row->line,
+                    row->len,
+                    &table.cells[(size_t)i * table.columns * 2]);
+
+        s += row->len + 1;
+    }
+
+    table_sort();
+}
+
+/* Render rows in sorted order */
+char * table_render(size_t * size)
+{
+    char * buffer;
+    char * s;
+    int    i;
+
+    *size = 1;
+
+    for (i = 0; i < table.order_count; i++)
+    {
+        *size += table.rows[table.order[i]].len + 1;
+    }
+
+    if (!(buffer = (char *)malloc(*size)))
+    {
+        exit_failed(1, "Failed to allocate table");
+    }
+
+    s = buffer;
+
+    for (i = 0; i < table.order_count; i++)
+    {
+        const struct table_row * row = &table.rows[table.order[i]];
+
+        memcpy(s, row->line, row->len);
+
+        s    += row->len;
+        *s++  = '\n';
+    }
+
+    /* Drop final newline so no empty row is shown after the last one */
+    if (s != buffer)
+    {
+        s--;
+    }
+
+    *s    = '\0';
+    *size = s - buffer;
+
+    return buffer;
+}
+
+/* Render pinned header, sort column is highlighted */
+void table_header()
+{
+    const char * header = table.header;
+    int          c;
+
+    if (table.header_pad)
+    {
+        delwin(table.header_pad);
+    }
+
+    table.header_pad = newpad_buffer(header, table.header_len, NULL, NULL);
+
+    if (table.sort_column != -1)
+    {
+        int start = 0;
+        int end   = 0;
+        int pos   = 0;
+
+        for (c = 0; c <= table.sort_column; c++)
+        {
+            while (pos < table.header_len &&
+                   isspace((unsigned char)header[pos]))
+            {
+                pos++;
+            }
+
+            start = pos;
+
+            while (pos < table.header_len &&
+                   !isspace((unsigned char)header[pos]))
+            {
+                pos++;
+            }
+
+            end = pos;
+        }
+
+        /* Byte offsets to columns as laid out by newpad_buffer() */
+        start = glyph_line_width(header, start);
+        end   = glyph_line_width(header, end);
+
+        mvwchgat(table.header_pad,
+                 0,
+                 start,
+                 end - start,
+                 table.descending ? A_REVERSE | A_UNDERLINE : A_REVERSE,
+                 0,
+                 NULL);
+    }
+}
+
+/*******************************************************************************
+Split screen
+
+The rows below the header can be split into panes that each scroll on their
+own over the same pad. All panes are either stacked or side by side, a split
+in the other direction lays out all of them again. Panes share the snapshot,
+its line index and its decorations, only their positions differ, and all of
+them are copied to the screen before a single doupdate(). Line number entry
+is shared and moves the focused pane.
+*******************************************************************************/
+struct pane
+{
+    int top_row;
+    int left_col;
+};
+
+struct
+{
+    struct pane panes[MAX_PANES];
+    int         count;
+    int         current;
+    bool        side_by_side;
+} split = { { { 0, 0 } }, 1, 0, false };
+
+/* Return position and size of pane on screen, dividers are left between */
+void pane_area(int i, int * y, int * x, int * rows, int * cols)
+{
+    int size;
+
+    if (split.side_by_side)
+    {
+        size  = (COLS - (split.count - 1)) / split.count;
+        *y    = 1;
+        *x    = i * (size + 1);
+        *rows = LINES - 1;
+        *cols = (i == split.count - 1) ? COLS - *x : size;
+    }
+    else
+    {
+        size  = (LINES - 1 - (split.count - 1)) / split.count;
+        *y    = 1 + i * (size + 1);
+        *x    = 0;
+        *rows = (i == split.count - 1) ? LINES - *y : size;
+        *cols = COLS;
+    }
+}
+
+/* Return rows of pane showing the pad, below the table header if pinned */
+int pane_rows(int i)
+{
+    int y;
+    int x;
+    int rows;
+    int cols;
+
+    pane_area(i, &y, &x, &rows, &cols);
+
+    return rows - (table.enabled ? 1 : 0);
+}
+
+int pane_cols(int i)
+{
+    int y;
+    int x;
+    int rows;
+    int cols;
+
+    pane_area(i, &y, &x, &rows, &cols);
+
+    return cols;
+}
+
+int view_rows()
+{
+    return pane_rows(split.current);
+}
+
+int view_cols()
+{
+    return pane_cols(split.current);
+}
+
+/* Return true if the first pane, the smallest one, is big enough to use */
+bool split_fits()
+{
+    return pane_rows(0) >= 2 && pane_cols(0) >= 16;
+}
+
+/* Add pane after the focused one at the same position, lay out all panes */
+bool split_open(bool side_by_side)
+{
+    bool was_side_by_side = split.side_by_side;
+
+    if (split.count == MAX_PANES)
+    {
+        return false;
+    }
+
+    split.count++;
+
+    split.side_by_side = side_by_side;
+
+    if (!split_fits())
+    {
+        split.count--;
+
+        split.side_by_side = was_side_by_side;
+
+        return false;
+    }
+
+    memmove(&split.panes[split.current + 1],
+            &split.panes[split.current],
+            (split.count - split.current - 1) * sizeof(struct pane));
+
+    split.current++;
+
+    return true;
+}
+
+bool split_close()
+{
+    if (split.count == 1)
+    {
+        return false;
+    }
+
+    memmove(&split.panes[split.current],
+            &split.panes[split.current + 1],
+            (split.count - split.current - 1) * sizeof(struct pane));
+
+    split.count--;
+
+    if (split.current == split.count)
+    {
+        split.current--;
+    }
+
+    return true;
+}
+
+/* Close panes from the end until the rest fit the screen */
+void split_fit()
+{
+    while (split.count > 1 && !split_fits())
+    {
+        split.count--;
+    }
+
+    if (split.current >= split.count)
+    {
+        split.current = split.count - 1;
+    }
+}
+
+/* Keep all panes within the pad, and within its width after a resize */
+void split_clamp(bool resized)
+{
+    int i;
+
+    for (i = 0; i < split.count; i++)
+    {
+        struct pane * pane = &split.panes[i];
+        int           rows = pane_rows(i);
+        int           cols = pane_cols(i);
+
+        if (pane->top_row > (global.lines - rows))
+        {
+            if (global.lines > rows + 1)
+            {
+                pane->top_row = (global.lines - rows);
+            }
+            else
+            {
+                pane->top_row = 0;
+            }
+        }
+
+        if (resized && pane->left_col != 0)
+        {
+            if (pane->left_col + cols > global.display_cols)
+            {
+                pane->left_col = global.display_cols - cols;
+            }
+
+            if (pane->left_col < 0)
+            {
+                pane->left_col = 0;
+            }
+        }
+    }
+}
+
+bool split_visible_changed()
+{
+    int i;
+
+    for (i = 0; i < split.count; i++)
+    {
+        if (view_visible_changed(split.panes[i].top_row, pane_rows(i)))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void split_tag(char * tag, size_t size)
+{
+    if (split.count > 1)
+    {
+        snprintf(tag, size, "[%d/%d] ", split.current + 1, split.count);
+    }
+    else
+    {
+        tag[0] = '\0';
+    }
+}
+
+/*******************************************************************************
+Counter rate mode
+
+Numbers on each line are matched by position against the same line in the
+previous snapshot and shown as a change per second. Lines are identified by
+their text with all numbers masked out plus an occurrence count for lines
+that are identical after masking. Digits that are part of a word (eth0,
+cpu3) are kept as text so they keep lines apart.
+*******************************************************************************/
+struct rate_number
+{
+    uint64_t integer;
+    double   value;
+    bool     exact; /* Non-negative integer, integer holds all digits */
+};
+
+struct rate_line
+{
+    uint64_t key; /* Zero marks an empty slot */
+    int      first;
+    int      count;
+};
+
+struct
+{
+    bool                 enabled;
+    bool                 replace;
+    struct rate_line *   lines;
+    size_t               line_mask;
+    struct rate_number * numbers;
+    int                  number_count;
+    struct timespec      time;
+} rate = { false, false, NULL, 0, NULL, 0, { 0, 0 } };
+
+bool rate_word_char(char c)
+{
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+/* Parse number at s if it is not part of a word, return its length */
+int rate_token(const char * line,
+               const char * s,
+               const char * end,
+               struct rate_number * number)
+{
+    const char * start = s;
+    bool         negative;
+
+    if (s > line && (rate_word_char(s[-1]) || s[-1] == '.'))
+    {
+        return 0;
+    }
+
+    negative = (*s == '-');
+
+    if (negative)
+    {
+        s++;
+    }
+
+    if (s == end || !isdigit((unsigned char)*s))
+    {
+        return 0;
+    }
+
+    number->integer = 0;
+
+    while (s < end && isdigit((unsigned char)*s))
+    {
+        unsigned digit = *s++ - '0';
+
+        /* Numbers beyond 64 bits are left as text */
+        if (number->integer > (UINT64_MAX - digit) / 10)
+        {
+            return 0;
+        }
+
+        number->integer = number->integer * 10 + digit;
+    }
+
+    number->value = (double)number->integer;
+    number->exact = !negative;
+
+    if (s + 1 < end && *s == '.' && isdigit((unsigned char)s[1]))
+    {
+        double scale = 1;
+
+        for (s++; s < end && isdigit((unsigned char)*s); s++)
+        {
+            scale         /= 10;
+            number->value += (*s - '0') * scale;
+        }
+
+        number->exact = false;
+    }
+
+    if (s < end && rate_word_char(*s))
+    {
+        return 0;
+    }
+
+    if (negative)
+    {
+        number->value = -number->value;
+    }
+
+    return (int)(s - start);
+}
+
+double rate_delta(const struct rate_number * current,
+                  const struct rate_number * previous)
+{
+    /* Keep full precision for 64 bit counters */
+    if (current->exact && previous->exact)
+    {
+        return (double)(int64_t)(current->integer - previous->integer);
+    }
+
+    return current->value - previous->value;
+}
+
+const struct rate_line * rate_find(uint64_t key)
+{
+    size_t i;
+
+    if (!rate.lines)
+    {
+        return NULL;
+    }
+
+    for (i = key & rate.line_mask; rate.lines[i].key;
+         i = (i + 1) & rate.line_mask)
+    {
+        if (rate.lines[i].key == key)
+        {
+            return &rate.lines[i];
+        }
+    }
+
+    return NULL;
+}
+
+char * rate_apply(const char * buffer, size_t size, size_t * output_size)
+{
+    struct rate_line *   lines;
+    struct rate_number * numbers;
+    struct rate_line *   occurrences;
+    struct text          output;
+    struct timespec      now;
+    double               seconds;
+    size_t               mask;
+    const char *         s;
+    const char *         buffer_end;
+    int *                spans;
+    int                  span_capacity;
+    int                  number_capacity;
+    int                  number_count;
+    int                  lines_total;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    seconds = (now.tv_sec - rate.time.tv_sec) +
+              (now.tv_nsec - rate.time.tv_nsec) / 1e9;
+
+    /* Size line tables for this snapshot */
+    lines_total = line_count(buffer, size);
+    buffer_end  = buffer + size;
+
+    for (mask = 15; mask < (size_t)lines_total * 2; mask = mask * 2 + 1) { }
+
+    lines       = (struct rate_line *)calloc(mask + 1, sizeof(*lines));
+    occurrences = (struct rate_line *)calloc(mask + 1, sizeof(*occurrences));
+
+    number_capacity = 1024;
+    number_count    = 0;
+    numbers = (struct rate_number *)malloc(number_capacity * sizeof(*numbers));
+
+    span_capacity = 64;
+    spans         = (int *)malloc(span_capacity * sizeof(*spans));
+
+    if (!lines || !occurrences || !numbers || !spans)
+    {
+        exit_failed(1, "Failed to allocate rate workspace");
+    }
+
+    text_init(&output, size + 1);
+
+    for (s = buffer;;)
+    {
+        const char *             end   = s + line_length(s, buffer_end);
+        const char *             p     = s;
+        uint64_t                 hash  = HASH_SEED;
+        int                      first = number_count;
+        int                      count = 0;
+        const struct rate_line * previous;
+        uint64_t                 key;
+        size_t                   i;
+        int                      j;
+
+        /* Tokenize numbers, hash the text between them */
+        while (p < end)
+        {
+            const char * start = p;
+            int          len   = 0;
+
+            while (p < end &&
+                   !((isdigit((unsigned char)*p) || *p == '-') &&
+                     (len = rate_token(s, p, end, &numbers[number_count]))))
+            {
+                p++;
+            }
+
+            hash = hash_update(hash, start, p - start);
+
+            if (p == end)
+            {
+                break;
+            }
+
+            hash = hash_update(hash, "#", 1);
+
+            if (count * 2 + 2 > span_capacity)
+            {
+                span_capacity *= 2;
+
+                if (!(spans = (int *)realloc(spans,
+                                             span_capacity * sizeof(*spans))))
+                {
+                    exit_failed(1, "Failed to allocate rate workspace");
+                }
+            }
+
+            spans[count * 2]     = (int)(p - s);
+            spans[count * 2 + 1] = len;
+
+            count++;
+            p += len;
+
+            if (++number_count == number_capacity)
+            {
+                number_capacity *= 2;
+
+                if (!(numbers = (struct rate_number *)realloc(
+                          numbers, number_capacity * sizeof(*numbers))))
+                {
+                    exit_failed(1, "Failed to allocate rate workspace");
+                }
+            }
+        }
+
+        /* Tell apart lines that are identical after masking */
+        i = hash & mask;
+
+        while (occurrences[i].key && occurrences[i].key != hash)
+        {
+            i = (i + 1) & mask;
+        }
+
+        occurrences[i].key = hash;
+        key = hash ^ ((uint64_t)occurrences[i].count++ *
+                      UINT64_C(0x9e3779b97f4a7c15));
+        key = key ? key : 1;
+
+        i = key & mask;
+
+        while (lines[i].key)
+        {
+            i = (i + 1) & mask;
+        }
+
+        lines[i].key   = key;
+        lines[i].first = first;
+        lines[i].count = count;
+
+        /* Render line with rates */
+        previous = (seconds > 0) ? rate_find(key) : NULL;
+        p        = s;
+
+        for (j = 0; j < count; j++)
+        {
+            const char * token = s + spans[j * 2];
+            int          len   = spans[j * 2 + 1];
+            char         text[32];
+            double       per_second;
+
+            text_append(&output, p, token - p);
+
+            p = token + len;
+
+            if (!previous || j >= previous->count)
+            {
+                text_append(&output, token, len);
+
+                continue;
+            }
+
+            per_second = rate_delta(&numbers[first + j],
+                                    &rate.numbers[previous->first + j]) /
+                         seconds;
+
+            if (!rate.replace)
+            {
+                text_append(&output, token, len);
+
+                if (per_second == 0)
+                {
+                    continue;
+                }
+            }
+
+            snprintf(text,
+                     sizeof(text),
+                     rate.replace ? "%.*f/s" : "(%+.*f/s)",
+                     (per_second > -100 && per_second < 100) ? 1 : 0,
+                     per_second);
+
+            text_append(&output, text, strlen(text));
+        }
+
+        text_append(&output, p, end - p);
+
+        if (end == buffer_end)
+        {
+            break;
+        }
+
+        text_append(&output, "\n", 1);
+
+        s = end + 1;
+    }
+
+    /* Current snapshot becomes the previous one */
+    free(rate.lines);
+    free(rate.numbers);
+    free(occurrences);
+    free(spans);
+
+    rate.lines        = lines;
+    rate.line_mask    = mask;
+    rate.numbers      = numbers;
+    rate.number_count = number_count;
+    rate.time         = now;
+
+    *output_size = output.size;
+
+    return output.data;
+}
+
+/*******************************************************************************
+Outline mode
+
+One pass over the snapshot records the nesting of every line: the bracket
+depth at its start (closing brackets at the start of a line count as being
+outside) followed by its indentation, so JSON nests by brackets and YAML by
+indentation. Lines nested deeper than the line before them form that line's
+subtree. Subtrees are folded by path, a hash of the keys of the enclosing
+lines, so folds survive refreshes that move lines around. Only unfolded
+lines are copied into the displayed text.
+*******************************************************************************/
+struct outline_line
+{
+    size_t   start;
+    int      len;
+    int      depth;
+    int      indent;
+    int      end; /* Last line of subtree, the line itself when not a parent */
+    int      level;
+    uint64_t path;
+};
+
+struct outline_parent
+{
+    int line;
+    int children;
+};
+
+struct
+{
+    bool                  enabled;
+    char *                source;
+    struct outline_line * lines;
+    int                   line_count;
+    uint64_t *            folded;
+    int                   folded_count;
+    int *                 rows;
+} outline = { false, NULL, NULL, 0, NULL, 0, NULL };
+
+/* Compare nesting, positive when line a is nested deeper than line b */
+int outline_compare(const struct outline_line * a,
+                    const struct outline_line * b)
+{
+    if (a->depth != b->depth)
+    {
+        return a->depth - b->depth;
+    }
+
+    return a->indent - b->indent;
+}
+
+/* Hash the key that names line among its siblings */
+uint64_t outline_path(uint64_t parent, const char * s, int len, int child)
+{
+    char         index[16];
+    const char * colon;
+    int          i;
+
+    for (i = 0; i < len && (s[i] == ' ' || s[i] == '\t'); i++) { }
+
+    s   += i;
+    len -= i;
+
+    parent = hash_update(parent, "/", 1);
+
+    /* YAML list items are named by their content */
+    if (len >= 2 && s[0] == '-' && s[1] == ' ')
+    {
+        return hash_update(parent, s, len);
+    }
+
+    /* Keys of JSON objects and YAML mappings */
+    if ((colon = (const char *)memchr(s, ':', len)))
+    {
+        return hash_update(parent, s, colon - s);
+    }
+
+    /* Anything else, e.g. elements of JSON arrays, by position */
+    snprintf(index, sizeof(index), "#%d", child);
+
+    return hash_update(parent, index, strlen(index));
+}
+
+int outline_folded_find(uint64_t path)
+{
+    int lo = 0;
+    int hi = outline.folded_count;
+
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+
+        if (outline.folded[mid] < path)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+bool outline_is_folded(uint64_t path)
+{
+    int i = outline_folded_find(path);
+
+    return i < outline.folded_count && outline.folded[i] == path;
+}
+
+void outline_fold(uint64_t path, bool fold)
+{
+    int i = outline_folded_find(path);
+
+    if (i < outline.folded_count && outline.folded[i] == path)
+    {
+        if (!fold)
+        {
+            memmove(&outline.folded[i],
+                    &outline.folded[i + 1],
+                    (outline.folded_count - i - 1) * sizeof(*outline.folded));
+
+            outline.folded_count--;
+        }
+    }
+    else if (fold)
+    {
+        uint64_t * folded;
+
+        if (!(folded = (uint64_t *)realloc(outline.folded,
+                                           (outline.folded_count + 1) *
+                                               sizeof(*folded))))
+        {
+            exit_failed(1, "Failed to allocate outline");
+        }
+
+        outline.folded = folded;
+
+        memmove(&outline.folded[i + 1],
+                &outline.folded[i],
+                (outline.folded_count - i) * sizeof(*outline.folded));
+
+        outline.folded[i] = path;
+
+        outline.folded_count++;
+    }
+}
+
+/* Index nesting of every line */
+void outline_load(const char * buffer, size_t size)
+{
+    struct outline_parent * stack;
+    const char *            s;
+    const char *            end;
+    int                     stack_size;
+    int                     depth;
+    int                     count;
+    int                     i;
+
+    free(outline.source);
+    free(outline.lines);
+
+    if (!(outline.source = (char *)malloc(size + 1)))
+    {
+        exit_failed(1, "Failed to allocate outline");
+    }
+
+    memcpy(outline.source, buffer, size);
+
+    outline.source[size] = '\0';
+
+    end   = outline.source + size;
+    count = line_count(outline.source, size);
+
+    outline.lines = (struct outline_line *)malloc(count *
+                                                  sizeof(*outline.lines));
+    stack         = (struct outline_parent *)malloc((count + 1) *
+                                                    sizeof(*stack));
+
+    if (!outline.lines || !stack)
+    {
+        exit_failed(1, "Failed to allocate outline");
+    }
+
+    outline.line_count = count;
+
+    /* Root of the stack stands in for the document */
+    stack[0].line     = -1;
+    stack[0].children = 0;
+    stack_size        = 1;
+    depth             = 0;
+
+    for (i = 0, s = outline.source; i < count; i++)
+    {
+        struct outline_line * line = &outline.lines[i];
+        const char *          p;
+        struct outline_line * closed;
+        bool                  in_string;
+        bool                  closing;
+        bool                  blank;
+
+        line->start = s - outline.source;
+        line->len   = line_length(s, end);
+        line->end   = i;
+
+        /* Indentation, YAML list items nest under their key */
+        for (p = s; *p == ' ' || *p == '\t'; p++) { }
+
+        line->indent = (int)(p - s);
+        blank        = (p == s + line->len);
+
+        if (p[0] == '-' && p[1] == ' ')
+        {
+            line->indent++;
+        }
+
+        /* Closing brackets at the start belong to the enclosing level */
+        closing = (*p == '}' || *p == ']');
+
+        for (; *p == '}' || *p == ']'; p++)
+        {
+            depth -= (depth > 0);
+
+            while (p[1] == ',' || p[1] == ' ')
+            {
+                p++;
+            }
+        }
+
+        line->depth = depth;
+
+        /* Track bracket depth through the rest of the line */
+        for (in_string = false; p < s + line->len; p++)
+        {
+            if (in_string)
+            {
+                if (*p == '\\' && p + 1 < s + line->len)
+                {
+                    p++;
+                }
+                else if (*p == '"')
+                {
+                    in_string = false;
+                }
+            }
+            else if (*p == '"')
+            {
+                in_string = true;
+            }
+            else if (*p == '{' || *p == '[')
+            {
+                depth++;
+            }
+            else if ((*p == '}' || *p == ']') && depth > 0)
+            {
+                depth--;
+            }
+        }
+
+        /* Close subtrees this line is not nested in, a closing bracket */
+        /* at the level of the line that opened it ends that subtree */
+        closed = NULL;
+
+        while (!blank && stack_size > 1)
+        {
+            struct outline_line * top;
+
+            top = &outline.lines[stack[stack_size - 1].line];
+
+            if (outline_compare(line, top) > 0)
+            {
+                break;
+            }
+
+            top->end = i - 1;
+            closed   = top;
+
+            stack_size--;
+        }
+
+        if (closing && closed && !outline_compare(line, closed))
+        {
+            closed->end = i;
+            blank       = true; /* Not a parent of what follows */
+        }
+
+        line->level = stack_size - 1;
+        line->path =
+            outline_path((stack_size > 1) ?
+                             outline.lines[stack[stack_size - 1].line].path :
+                             HASH_SEED,
+                         s,
+                         line->len,
+                         stack[stack_size - 1].children++);
+
+        if (!blank)
+        {
+            stack[stack_size].line     = i;
+            stack[stack_size].children = 0;
+            stack_size++;
+        }
+
+        s += line->len + 1;
+    }
+
+    while (stack_size > 1)
+    {
+        outline.lines[stack[--stack_size].line].end = count - 1;
+    }
+
+    /* Trailing blank lines do not belong to the last subtree */
+    for (i = 0; i < count; i++)
+    {
+        struct outline_line * line = &outline.lines[i];
+
+        while (line->end > i && outline.lines[line->end].len == 0)
+        {
+            line->end--;
+        }
+    }
+
+    free(stack);
+}
+
+/* Copy unfolded lines to displayed text, map rows to source lines */
+char * outline_render(size_t * size)
+{
+    struct text output;
+    int         rows;
+    int         i;
+
+    free(outline.rows);
+
+    if (!(outline.rows = (int *)malloc(outline.line_count *
+                                       sizeof(*outline.rows))))
+    {
+        exit_failed(1, "Failed to allocate outline");
+    }
+
+    text_init(&output, 4096);
+
+    for (rows = 0, i = 0; i < outline.line_count; i++)
+    {
+        const struct outline_line * line = &outline.lines[i];
+
+        if (rows)
+        {
+            text_append(&output, "\n", 1);
+        }
+
+        outline.rows[rows++] = i;
+
+        text_append(&output, &outline.source[line->start], line->len);
+
+        if (line->end > i && outline_is_folded(line->path))
+        {
+            char marker[32];
+
+            snprintf(marker,
+                     sizeof(marker),
+                     " ... +%d lines",
+                     line->end - i);
+
+            text_append(&output, marker, strlen(marker));
+
+            i = line->end;
+        }
+    }
+
+    global.row_map       = outline.rows;
+    global.row_map_lines = outline.line_count;
+
+    *size = output.size;
+
+    return output.data;
+}
+
+/* Fold or unfold subtree of line shown in row */
+bool outline_toggle(int row)
+{
+    const struct outline_line * line;
+
+    if (row < 0 || row >= global.lines)
+    {
+        return false;
+    }
+
+    line = &outline.lines[outline.rows[row]];
+
+    if (line->end == outline.rows[row])
+    {
+        return false;
+    }
+
+    outline_fold(line->path, !outline_is_folded(line->path));
+
+    return true;
+}
+
+/* Return gutter marker for row, '+' when folded and '-' when unfolded */
+chtype outline_marker(int row)
+{
+    const struct outline_line * line = &outline.lines[outline.rows[row]];
+
+    if (line->end == outline.rows[row])
+    {
+        return ' ';
+    }
+
+    return outline_is_folded(line->path) ? '+' : '-';
+}
+
+/* Fold every subtree below the first two levels, or unfold everything */
+void outline_fold_all(bool fold)
+{
+    int i;
+
+    if (!fold)
+    {
+        outline.folded_count = 0;
+
+        return;
+    }
+
+    for (i = 0; i < outline.line_count; i++)
+    {
+        const struct outline_line * line = &outline.lines[i];
+
+        if (line->end > i && line->level >= 1)
+        {
+            outline_fold(line->path, true);
+        }
+    }
+}
+
+/*******************************************************************************
+Collapse repeated lines
+
+Runs of consecutive identical lines are shown as their first line followed
+by the length of the run. Digits can be masked so lines that only differ in
+numbers (timestamps, counters, ports) form runs too. Rows are mapped to the
+first line of their run so line numbers refer to the original output.
+*******************************************************************************/
+struct
+{
+    bool  enabled;
+    bool  digits;
+    int * rows;
+} collapse = { false, false, NULL };
+
+/* Compare lines, runs of digits compare equal when digits are masked */
+bool collapse_same(const char * a, int a_len, const char * b, int b_len)
+{
+    const char * a_end = a + a_len;
+    const char * b_end = b + b_len;
+
+    if (!collapse.digits)
+    {
+        return a_len == b_len && !memcmp(a, b, a_len);
+    }
+
+    while (a < a_end && b < b_end)
+    {
+        if (isdigit((unsigned char)*a) && isdigit((unsigned char)*b))
+        {
+            while (a < a_end && isdigit((unsigned char)*a)) a++;
+            while (b < b_end && isdigit((unsigned char)*b)) b++;
+        }
+        else if (*a++ != *b++)
+        {
+            return false;
+        }
+    }
+
+    return a == a_end && b == b_end;
+}
+
+char * collapse_apply(const char * buffer, size_t size, size_t * output_size)
+{
+    struct text  output;
+    const char * end;
+    const char * s;
+    int          lines;
+    int          rows;
+    int          i;
+
+    end   = buffer + size;
+    lines = line_count(buffer, size);
+
+    free(collapse.rows);
+
+    if (!(collapse.rows = (int *)malloc(lines * sizeof(*collapse.rows))))
+    {
+        exit_failed(1, "Failed to allocate collapse index");
+    }
+
+    text_init(&output, size + 1);
+
+    for (rows = 0, s = buffer, i = 0; i < lines;)
+    {
+        const char * line = s;
+        int          len  = (int)line_length(s, end);
+        int          run;
+
+        /* Extend run over following lines that are the same */
+        for (run = 1, s += len + 1; i + run < lines; run++)
+        {
+            int next_len = (int)line_length(s, end);
+
+            if (!collapse_same(line, len, s, next_len))
+            {
+                break;
+            }
+
+            s += next_len + 1;
+        }
+
+        if (rows)
+        {
+            text_append(&output, "\n", 1);
+        }
+
+        collapse.rows[rows++] = i;
+
+        text_append(&output, line, len);
+
+        if (run > 1)
+        {
+            char marker[32];
+
+            snprintf(marker, sizeof(marker), " [x%d]", run);
+
+            text_append(&output, marker, strlen(marker));
+        }
+
+        i += run;
+    }
+
+    global.row_map       = collapse.rows;
+    global.row_map_lines = lines;
+
+    *output_size = output.size;
+
+    return output.data;
+}
+
+/*******************************************************************************
+Follow end of output
+
+After End the view follows the end of the output. Each snapshot is then
+scanned backwards for just enough lines to fill the screen and only those
+are indexed and rendered. Line numbers are unknown until the newlines before
+them are counted, a chunk at a time between key reads. The whole snapshot is
+kept so the full view can be built once the view leaves the end.
+*******************************************************************************/
+struct
+{
+    bool   anchored; /* End was pressed, follow the end of the output */
+    bool   active;   /* Pad holds only the end of the snapshot */
+    char * text;
+    size_t size;
+    size_t offset;   /* Start of first line shown */
+    size_t counted;  /* Bytes before offset scanned for newlines */
+    int    first_line;
+    bool   known;    /* Line number of the first line shown is known */
+} tail = { false, false, NULL, 0, 0, 0, 0, false };
+
+/* Return start of the last lines of text, counting an empty last line */
+size_t tail_start(const char * buffer, size_t size, int lines)
+{
+    const char * s = buffer + size;
+
+    while (s > buffer)
+    {
+        if (s[-1] == '\n' && --lines == 0)
+        {
+            break;
+        }
+
+        s--;
+    }
+
+    return s - buffer;
+}
+
+/* Count newlines before the lines shown, return true when done */
+bool tail_count()
+{
+    size_t       chunk = TAIL_INDEX_CHUNK;
+    const char * s;
+    const char * end;
+
+    if (!tail.active || tail.known)
+    {
+        return false;
+    }
+
+    if (chunk > tail.offset - tail.counted)
+    {
+        chunk = tail.offset - tail.counted;
+    }
+
+    s   = tail.text + tail.counted;
+    end = s + chunk;
+
+    while ((s = (const char *)memchr(s, '\n', end - s)))
+    {
+        tail.first_line++;
+        s++;
+    }
+
+    tail.counted += chunk;
+    tail.known    = (tail.counted == tail.offset);
+
+    if (tail.known)
+    {
+        global.lines_digits = count_int_chars(tail.first_line + global.lines);
+        global.display_cols = global.cols +
+                              ((global.show_lineno) ? global.lines_digits + 1 :
+                                                      0);
+    }
+
+    return tail.known;
+}
+
+/* Return true for keys that scroll away from the end or split the screen */
+bool tail_leaves(int ch)
+{
+    switch (ch)
+    {
+        case KEY_UP:
+        case 'w':
+        case KEY_PPAGE:
+        case 'b':
+        case KEY_HOME:
+        case 'h':
+        case '-':
+        case '|':
+        {
+            return true;
+        }
+        default:
+        {
+            return ch >= '0' && ch <= '9'; /* Goto line */
+        }
+    }
+}
+
+/*******************************************************************************
+Create pad from displayed text and update its dimensions
+*******************************************************************************/
+/* Return source line shown in row of displayed text, -1 if unknown */
+int row_line(int row)
+{
+    if (tail.active)
+    {
+        return (tail.known) ? tail.first_line + row : -1;
+    }
+
+    return (global.row_map) ? global.row_map[row] : row;
+}
+
+/* Return row showing source line, or the closest row before it */
+int line_row(int line)
+{
+    int lo = 0;
+    int hi = global.lines;
+
+    if (!global.row_map)
+    {
+        return line;
+    }
+
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+
+        if (global.row_map[mid] <= line)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return (lo > 0) ? lo - 1 : 0;
+}
+
+WINDOW * newpad_view(const char * buffer, size_t size)
+{
+    WINDOW * pad;
+
+    pad = view_patch(buffer, size);
+
+    /* Line numbers refer to the source when rows are mapped */
+    global.lines_digits = count_int_chars((global.row_map) ?
+                                              global.row_map_lines :
+                                              global.lines);
+
+    global.display_cols =
+        global.cols + ((global.show_lineno) ? global.lines_digits + 1 : 0) +
+        ((outline.enabled) ? 2 : 0);
+
+    return pad;
+}
+
+/*******************************************************************************
+Create pad from table rows in current sort order
+*******************************************************************************/
+WINDOW * newpad_table()
+{
+    WINDOW * pad;
+    char *   buffer;
+    size_t   size;
+
+    table_header();
+
+    buffer = table_render(&size);
+
+    pad = newpad_view(buffer, size);
+
+    free(buffer);
+
+    return pad;
+}
+
+/*******************************************************************************
+Create pad from outline with folded subtrees hidden
+*******************************************************************************/
+WINDOW * newpad_outline()
+{
+    WINDOW * pad;
+    char *   buffer;
+    size_t   size;
+
+    buffer = outline_render(&size);
+
+    pad = newpad_view(buffer, size);
+
+    free(buffer);
+
+    return pad;
+}
+
+/*******************************************************************************
+Create pad from end of snapshot, or from all of it when leaving the end
+*******************************************************************************/
+WINDOW * newpad_tail(const char * buffer, size_t size)
+{
+    if (buffer != tail.text)
+    {
+        char * text;
+
+        if (!(text = (char *)malloc(size + 1)))
+        {
+            exit_failed(1, "Failed to allocate snapshot buffer");
+        }
+
+        memcpy(text, buffer, size);
+
+        text[size] = '\0';
+
+        free(tail.text);
+
+        tail.text = text;
+        tail.size = size;
+    }
+
+    /* Two extra lines keep the last line on screen as after End */
+    tail.offset     = tail_start(tail.text, tail.size, view_rows() + 2);
+    tail.counted    = 0;
+    tail.first_line = 0;
+    tail.known      = (tail.offset == 0);
+    tail.active     = true;
+
+    return newpad_view(tail.text + tail.offset, tail.size - tail.offset);
+}
+
+/* Return top row showing the last lines of the pad, as after End */
+int tail_top()
+{
+    return (global.lines > view_rows()) ? (global.lines - view_rows()) : 0;
+}
+
+WINDOW * tail_expand()
+{
+    tail.active   = false;
+    tail.anchored = false;
+
+    return newpad_view(tail.text, tail.size);
+}
+
+/*******************************************************************************
+Create pad from snapshot
+*******************************************************************************/
+WINDOW * newpad_snapshot(const char * buffer, size_t size)
+{
+    WINDOW * pad;
+    char *   rated;
+    char *   collapsed;
+
+    rated     = NULL;
+    collapsed = NULL;
+
+    if (rate.enabled)
+    {
+        buffer = rated = rate_apply(buffer, size, &size);
+    }
+
+    if (table.enabled)
+    {
+        table_load(buffer, size);
+
+        pad = newpad_table();
+    }
+    else if (outline.enabled)
+    {
+        outline_load(buffer, size);
+
+        pad = newpad_outline();
+    }
+    else if (collapse.enabled)
+    {
+        buffer = collapsed = collapse_apply(buffer, size, &size);
+
+        pad = newpad_view(buffer, size);
+    }
+    else if (tail.anchored)
+    {
+        pad = newpad_tail(buffer, size);
+    }
+    else
+    {
+        free(tail.text);
+
+        tail.text   = NULL;
+        tail.active = false;
+
+        pad = newpad_view(buffer, size);
+    }
+
+    free(rated);
+    free(collapsed);
+
+    return pad;
+}
+
+/*******************************************************************************
+Share snapshots over a Unix domain socket
+
+A server runs the command and publishes every snapshot to attached clients.
+Each message carries the command line and the bytes that differ from the
+previous snapshot, clients rebuild the snapshot from their copy of it.
+Messages are queued per client and sent without blocking as clients read
+them, clients that fall two buffers behind are dropped. Clients accept
+snapshots up to their own buffer size, attach with the -b of the server.
+*******************************************************************************/
+struct snapshot_header
+{
+    uint32_t magic;
+    uint32_t interval;
+    int64_t  cmd_time;
+    uint32_t cmd_len;
+    uint32_t prefix; /* Bytes reused from the start of the previous snapshot */
+    uint32_t suffix; /* Bytes reused from the end of the previous snapshot */
+    uint32_t length; /* Bytes of new data following the command */
+};
+
+struct serve_client
+{
+    int    fd;
+    char * queue; /* Messages not yet taken by the client */
+    size_t queue_size;
+    size_t queue_sent;
+};
+
+struct
+{
+    int                 listen_fd;
+    struct serve_client clients[MAX_CLIENTS];
+    int                 client_count;
+    char *              last;
+    size_t              last_size;
+    time_t              last_time;
+} serve = { -1, { { 0, NULL, 0, 0 } }, 0, NULL, 0, 0 };
+
+struct
+{
+    int    fd;
+    char * last;
+    size_t last_size;
+    bool   pending;
+    time_t retry_time;
+} attach = { -1, NULL, 0, false, 0 };
+
+bool socket_address(const char * path, struct sockaddr_un * addr)
+{
+    memset(addr, 0, sizeof(*addr));
+
+    addr->sun_family = AF_UNIX;
+
+    if (strlen(path) >= sizeof(addr->sun_path))
+    {
+        return false;
+    }
+
+    strcpy(addr->sun_path, path);
+
+    return true;
+}
+
+void socket_timeout(int fd, int option_name, int seconds)
+{
+    struct timeval tv;
+
+    tv.tv_sec  = seconds;
+    tv.tv_usec = 0;
+
+    setsockopt(fd, SOL_SOCKET, option_name, &tv, sizeof(tv));
+}
+
+bool recv_full(int fd, void * data, size_t size)
+{
+    char * s = (char *)data;
+
+    while (size)
+    {
+        ssize_t retval = recv(fd, s, size, 0);
+
+        if (retval == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (retval <= 0)
+        {
+            return false;
+        }
+
+        s    += retval;
+        size -= retval;
+    }
+
+    return true;
+}
+
+void serve_cleanup()
+{
+    if (serve.listen_fd != -1)
+    {
+        unlink(global.serve_path);
+    }
+}
+
+void serve_init()
+{
+    struct sockaddr_un addr;
+    int                fd;
+
+    if (!socket_address(global.serve_path, &addr))
+    {
+        exit_failed(2, "Socket path too long: '%s'", global.serve_path);
+    }
+
+    /* Refuse to take over the socket of a running server */
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+    {
+        exit_failed(1, "Error: socket(): %s", strerror(errno));
+    }
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+    {
+        exit_failed(2, "Socket in use: '%s'", global.serve_path);
+    }
+    else if (errno == ECONNREFUSED)
+    {
+        struct stat st;
+
+        /* Regular files refuse connections too, only remove sockets */
+        if (lstat(global.serve_path, &st) == 0 && !S_ISSOCK(st.st_mode))
+        {
+            exit_failed(2,
+                        "Path exists and is not a socket: '%s'",
+                        global.serve_path);
+        }
+
+        unlink(global.serve_path); /* Stale socket */
+    }
+
+    close(fd);
+
+    /* Listen for clients without blocking the capture loop */
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+    {
+        exit_failed(1, "Error: socket(): %s", strerror(errno));
+    }
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        exit_failed(1,
+                    "Error: bind(%s): %s",
+                    global.serve_path,
+                    strerror(errno));
+    }
+
+    if (listen(fd, MAX_CLIENTS) == -1)
+    {
+        exit_failed(1, "Error: listen(): %s", strerror(errno));
+    }
+
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    serve.listen_fd = fd;
+
+    atexit(serve_cleanup);
+}
+
+/* Send as much of the queue as the socket takes, false if client is gone */
+bool serve_flush(struct serve_client * client)
+{
+    while (client->queue_sent < client->queue_size)
+    {
+        ssize_t retval = send(client->fd,
+                              &client->queue[client->queue_sent],
+                              client->queue_size - client->queue_sent,
+                              MSG_NOSIGNAL | MSG_DONTWAIT);
+
+        if (retval == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+
+        client->queue_sent += retval;
+    }
+
+    free(client->queue);
+
+    client->queue      = NULL;
+    client->queue_size = 0;
+    client->queue_sent = 0;
+
+    return true;
+}
+
+/* Queue message and start sending it, false if client fell too far behind */
+bool serve_send(struct serve_client *           client,
+                const struct snapshot_header * header,
+                const char *                    data)
+{
+    size_t size = sizeof(*header) + header->cmd_len + header->length;
+    size_t kept = client->queue_size - client->queue_sent;
+    char * queue;
+
+    if (kept && kept + size > global.buffer_size * 2)
+    {
+        return false;
+    }
+
+    if (client->queue_sent)
+    {
+        memmove(client->queue, &client->queue[client->queue_sent], kept);
+    }
+
+    if (!(queue = (char *)realloc(client->queue, kept + size)))
+    {
+        exit_failed(1, "Failed to allocate client queue");
+    }
+
+    memcpy(&queue[kept], header, sizeof(*header));
+    memcpy(&queue[kept + sizeof(*header)], global.cmd, header->cmd_len);
+    memcpy(&queue[kept + sizeof(*header) + header->cmd_len],
+           data,
+           header->length);
+
+    client->queue      = queue;
+    client->queue_size = kept + size;
+    client->queue_sent = 0;
+
+    return serve_flush(client);
+}
+
+void serve_drop(int i)
+{
+    close(serve.clients[i].fd);
+    free(serve.clients[i].queue);
+
+    serve.clients[i] = serve.clients[--serve.client_count];
+}
+
+/* Take new clients and keep sending to clients with queued messages */
+void serve_accept()
+{
+    int fd;
+    int i;
+
+    while ((fd = accept(serve.listen_fd, NULL, NULL)) != -1)
+    {
+        struct serve_client *  client;
+        struct snapshot_header header;
+
+        if (serve.client_count == MAX_CLIENTS)
+        {
+            close(fd);
+
+            continue;
+        }
+
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+        client = &serve.clients[serve.client_count++];
+
+        client->fd         = fd;
+        client->queue      = NULL;
+        client->queue_size = 0;
+        client->queue_sent = 0;
+
+        /* Bring the new client up to date with a full snapshot */
+        if (serve.last)
+        {
+            header.magic    = SNAPSHOT_MAGIC;
+            header.interval = global.interval;
+            header.cmd_time = serve.last_time;
+            header.cmd_len  = strlen(global.cmd);
+            header.prefix   = 0;
+            header.suffix   = 0;
+            header.length   = serve.last_size;
+
+            if (!serve_send(client, &header, serve.last))
+            {
+                serve_drop(serve.client_count - 1);
+            }
+        }
+    }
+
+    for (i = 0; i < serve.client_count;)
+    {
+        if (serve.clients[i].queue && !serve_flush(&serve.clients[i]))
+        {
+            serve_drop(i);
+
+            continue;
+        }
+
+        i++;
+    }
+}
+
+void serve_publish(const char * buffer, size_t size)
+{
+    struct snapshot_header header;
+    size_t                 prefix;
+    size_t                 suffix;
+    size_t                 limit;
+    int                    i;
+
+    /* Find the changed region relative to the previous snapshot */
+    prefix = 0;
+    suffix = 0;
+    limit  = (size < serve.last_size) ? size : serve.last_size;
+
+    while (prefix < limit && buffer[prefix] == serve.last[prefix]) prefix++;
+
+    limit -= prefix;
+
+    while (suffix < limit && buffer[size - suffix - 1] ==
+                                 serve.last[serve.last_size - suffix - 1])
+    {
+        suffix++;
+    }
+
+    header.magic    = SNAPSHOT_MAGIC;
+    header.interval = global.interval;
+    header.cmd_time = time(NULL);
+    header.cmd_len  = strlen(global.cmd);
+    header.prefix   = prefix;
+    header.suffix   = suffix;
+    header.length   = size - prefix - suffix;
+
+    for (i = 0; i < serve.client_count;)
+    {
+        if (serve_send(&serve.clients[i], &header, &buffer[prefix]))
+        {
+            i++;
+
+            continue;
+        }
+
+        serve_drop(i);
+    }
+
+    /* Keep a copy for computing the next delta and for new clients */
+    if (serve.last_size < size || !serve.last)
+    {
+        free(serve.last);
+
+        if (!(serve.last = (char *)malloc(size + 1)))
+        {
+            exit_failed(1, "Failed to allocate snapshot buffer");
+        }
+    }
+
+    memcpy(serve.last, buffer, size);
+
+    serve.last_size = size;
+    serve.last_time = header.cmd_time;
+}
+
+bool attach_connect()
+{
+    struct sockaddr_un addr;
+    int                fd;
+
+    if (!socket_address(global.attach_path, &addr))
+    {
+        exit_failed(2, "Socket path too long: '%s'", global.attach_path);
+    }
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+    {
+        return false;
+    }
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        close(fd);
+
+        return false;
+    }
+
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    /* Do not hang on a server that stops mid-message */
+    socket_timeout(fd, SO_RCVTIMEO, global.timeout);
+
+    attach.fd = fd;
+
+    return true;
+}
+
+void attach_set(const char * buffer, size_t size)
+{
+    char * last;
+
+    if (!(last = (char *)malloc(size + 1)))
+    {
+        exit_failed(1, "Failed to allocate snapshot buffer");
+    }
+
+    memcpy(last, buffer, size);
+
+    last[size] = '\0';
+
+    free(attach.last);
+
+    attach.last      = last;
+    attach.last_size = size;
+    attach.pending   = true;
+}
+
+void attach_init()
+{
+    const char * WAITING_MSG = "\n\n\t\tWAITING FOR SERVER";
+
+    if (!attach_connect())
+    {
+        exit_failed(1,
+                     "Failed to connect to '%s': %s",
+                     global.attach_path,
+                     strerror(errno));
+    }
+
+    attach_set(WAITING_MSG, strlen(WAITING_MSG));
+
+    global.cmd_time = time(NULL);
+
+    if (!(global.cmd = (char *)calloc(1, 1)))
+    {
+        exit_failed(2, "malloc() failed");
+    }
+}
+
+bool attach_receive()
+{
+    const char *           DISCONNECTED_MSG =
+        "\n\n\t\tDISCONNECTED FROM SERVER";
+    struct snapshot_header header;
+    struct pollfd          pfd;
+    char *                 buffer;
+    size_t                 size;
+
+    /* Show local status messages before anything else */
+    if (attach.pending)
+    {
+        attach.pending = false;
+
+        return true;
+    }
+
+    /* Reconnect once per interval after losing the server */
+    if (attach.fd == -1)
+    {
+        if (time(NULL) - attach.retry_time < global.interval)
+        {
+            return false;
+        }
+
+        attach.retry_time = time(NULL);
+
+        if (!attach_connect())
+        {
+            return false;
+        }
+    }
+
+    pfd.fd     = attach.fd;
+    pfd.events = POLLIN;
+
+    if (poll(&pfd, 1, 0) != 1)
+    {
+        return false;
+    }
+
+    /* Receive and validate header */
+    if (!recv_full(attach.fd, &header, sizeof(header)) ||
+        header.magic != SNAPSHOT_MAGIC ||
+        header.cmd_len > SNAPSHOT_MAX_CMD ||
+        (size_t)header.prefix + header.suffix > attach.last_size ||
+        (size_t)header.prefix + header.suffix + header.length >
+            global.buffer_size + ELIDE_MARKER_SIZE)
+    {
+        goto disconnected;
+    }
+
+    /* Receive command */
+    if (!(buffer = (char *)realloc(global.cmd, header.cmd_len + 1)))
+    {
+        exit_failed(1, "Failed to allocate command buffer");
+    }
+
+    global.cmd = buffer;
+
+    if (!recv_full(attach.fd, global.cmd, header.cmd_len))
+    {
+        goto disconnected;
+    }
+
+    global.cmd[header.cmd_len] = '\0';
+
+    /* Rebuild snapshot from the previous one and the changed region */
+    size = (size_t)header.prefix + header.length + header.suffix;
+
+    if (!(buffer = (char *)malloc(size + 1)))
+    {
+        exit_failed(1, "Failed to allocate snapshot buffer");
+    }
+
+    memcpy(buffer, attach.last, header.prefix);
+
+    if (!recv_full(attach.fd, &buffer[header.prefix], header.length))
+    {
+        free(buffer);
+
+        goto disconnected;
+    }
+
+    memcpy(&buffer[header.prefix + header.length],
+           &attach.last[attach.last_size - header.suffix],
+           header.suffix);
+
+    buffer[size] = '\0';
+
+    free(attach.last);
+
+    attach.last      = buffer;
+    attach.last_size = size;
+
+    global.interval = (int)header.interval;
+    global.cmd_time = (time_t)header.cmd_time;
+
+    return true;
+
+disconnected:
+    close(attach.fd);
+
+    attach.fd         = -1;
+    attach.retry_time = time(NULL);
+
+    attach_set(DISCONNECTED_MSG, strlen(DISCONNECTED_MSG));
+
+    global.cmd_time = time(NULL);
+
+    return true;
+}
+
+/*******************************************************************************
+Capture snapshot from command, file or plugin and publish it when serving
+*******************************************************************************/
+char * capture(char * cmd, size_t * size)
+{
+    char * buffer;
+
+    if (global.file_path)
+    {
+        buffer = file_to_buffer(global.file_path, size);
+    }
+    else if (global.plugin_path)
+    {
+        buffer = plugin_to_buffer(size);
+    }
+    else
+    {
+        buffer = cmd_to_buffer(cmd, size);
+    }
+
+    if (!buffer)
+    {
+        exit_failed(1, "Failed to allocate command output buffer");
+    }
+
+    if (global.serve_path)
+    {
+        serve_publish(buffer, *size);
+    }
+
+    return buffer;
+}
+
+/*******************************************************************************
+Run command and create pad from results
+*******************************************************************************/
+WINDOW * newpad_cmd(char * cmd)
+{
+    WINDOW * pad;
+    char *   buffer;
+    size_t   size;
+
+    buffer = capture(cmd, &size);
+
+    pad = newpad_snapshot(buffer, size);
+
+    free(buffer);
+
+    return pad;
+}
+
+/*******************************************************************************
+Run without a terminal
+
+Snapshots are written to stdout instead of the screen, either whole with a
+header line per run or as a delta of the lines that changed since the
+previous run. Deltas are unified diff hunks labeled with the time of the
+run: "@@ TIME -first,count +first,count @@" followed by removed lines
+prefixed with '-' and added lines prefixed with '+'. Runs that change
+nothing print nothing.
+*******************************************************************************/
+enum headless_format
+{
+    HEADLESS_OFF,
+    HEADLESS_FRAMES,
+    HEADLESS_DELTA
+};
+
+struct
+{
+    enum headless_format format;
+    char *               last;
+    size_t               last_size;
+    size_t *             offsets;
+    uint64_t *           hashes;
+    int                  lines;
+} headless = { HEADLESS_OFF, NULL, 0, NULL, NULL, 0 };
+
+void headless_lines(const char * prefix,
+                    const char * buffer,
+                    size_t       size,
+                    size_t *     offsets,
+                    int          first,
+                    int          count)
+{
+    const char * end = buffer + size;
+    int          i;
+
+    for (i = first; i < first + count; i++)
+    {
+        const char * line = &buffer[offsets[i]];
+
+        fputs(prefix, stdout);
+        fwrite(line, 1, line_length(line, end), stdout);
+        fputc('\n', stdout);
+    }
+}
+
+void headless_write(char * buffer, size_t size)
+{
+    char       timestamp[32];
+    time_t     now;
+    size_t *   offsets;
+    uint64_t * hashes;
+    int        lines;
+    int        prefix;
+    int        suffix;
+
+    now = time(NULL);
+
+    strftime(timestamp,
+             sizeof(timestamp),
+             "%Y-%m-%dT%H:%M:%S",
+             localtime(&now));
+
+    if (headless.format == HEADLESS_FRAMES)
+    {
+        char   stats[128];
+        size_t len;
+
+        run_tag(stats, sizeof(stats));
+
+        for (len = strlen(stats); len && stats[len - 1] == ' '; len--) { }
+
+        printf("--- %s %.*s%s%s\n",
+               timestamp,
+               (int)len,
+               stats,
+               len ? " | " : "",
+               global.cmd);
+
+        fwrite(buffer, 1, size, stdout);
+
+        if (size && buffer[size - 1] != '\n')
+        {
+            fputc('\n', stdout);
+        }
+
+        free(buffer);
+
+        return;
+    }
+
+    /* Compare line hashes with the previous snapshot, a final newline */
+    /* ends the last line instead of starting an empty one */
+    lines   = (size) ? line_count(buffer, size) - (buffer[size - 1] == '\n') :
+                       0;
+    offsets = (size_t *)malloc((lines + 1) * sizeof(*offsets));
+    hashes  = (uint64_t *)malloc((lines + 1) * sizeof(*hashes));
+
+    if (!offsets || !hashes)
+    {
+        exit_failed(1, "Failed to allocate line hashes");
+    }
+
+    line_index(buffer, size, lines, offsets, hashes);
+
+    line_match(hashes,
+               lines,
+               headless.hashes,
+               headless.lines,
+               &prefix,
+               &suffix);
+
+    if (prefix != lines || lines != headless.lines)
+    {
+        int removed = headless.lines - prefix - suffix;
+        int added   = lines - prefix - suffix;
+
+        printf("@@ %s -%d,%d +%d,%d @@\n",
+               timestamp,
+               prefix + (removed ? 1 : 0),
+               removed,
+               prefix + (added ? 1 : 0),
+               added);
+
+        headless_lines("-",
+                       headless.last,
+                       headless.last_size,
+                       headless.offsets,
+                       prefix,
+                       removed);
+        headless_lines("+", buffer, size, offsets, prefix, added);
+    }
+
+    /* Current snapshot becomes the previous one */
+    free(headless.last);
+    free(headless.offsets);
+    free(headless.hashes);
+
+    headless.last      = buffer;
+    headless.last_size = size;
+    headless.offsets   = offsets;
+    headless.hashes    = hashes;
+    headless.lines     = lines;
+}
+
+void headless_main()
+{
+    struct timespec last_cmd_time = { 0, 0 };
+
+    while (1)
+    {
+        struct timespec poll_time;
+        uint64_t        elapsed;
+        bool            changed;
+
+        if (global.serve_path)
+        {
+            serve_accept();
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &poll_time);
+
+        elapsed = poll_time.tv_sec - last_cmd_time.tv_sec -
+                  (poll_time.tv_nsec < last_cmd_time.tv_nsec);
+
+        /* Nothing is kept to shed, pressure still stretches the interval */
+        memory_check();
+
+        /* Events are read every pass so a run also covers those pending */
+        changed = on_change.count && on_change_due();
+
+        if (((int)elapsed >= memory_interval(global.interval) &&
+             (!global.file_path || file_changed())) ||
+            changed)
+        {
+            char * buffer;
+            char * text;
+            size_t size;
+
+            on_change.pending = false;
+
+            last_cmd_time = poll_time;
+
+            global.cmd_time = time(NULL);
+
+            buffer = capture(global.cmd, &size);
+
+            /* Text transforms apply, interactive views do not */
+            if (rate.enabled)
+            {
+                text = rate_apply(buffer, size, &size);
+
+                free(buffer);
+
+                buffer = text;
+            }
+
+            if (collapse.enabled)
+            {
+                text = collapse_apply(buffer, size, &size);
+
+                free(buffer);
+
+                buffer = text;
+            }
+
+            headless_write(buffer, size);
+
+            fflush(stdout);
+        }
+
+        poll(NULL, 0, 50); /* Delay 50ms */
+    }
+}
+
+/*******************************************************************************
+Read a line of text in the header row
+*******************************************************************************/
+bool prompt(const char * label, char * buffer, int size)
+{
+    bool accept;
+    int  len;
+    int  ch;
+
+    len       = 0;
+    buffer[0] = '\0';
+
+    nodelay(stdscr, false);
+
+    while (1)
+    {
+        mvprintw(0, 0, "%s%s", label, buffer);
+        clrtoeol();
+
+        ch = getch();
+
+        if (ch == ESCAPE)
+        {
+            accept = false;
+
+            break;
+        }
+        else if (ch == '\r' || ch == '\n' || ch == KEY_ENTER)
+        {
+            accept = true;
+
+            break;
+        }
+        else if (ch == KEY_BACKSPACE || ch == 127 || ch == CTRL('h'))
+        {
+            if (len)
+            {
+                buffer[--len] = '\0';
+            }
+        }
+        else if (ch >= ' ' && ch < 127 && len < size - 1)
+        {
+            buffer[len++] = (char)ch;
+            buffer[len]   = '\0';
+        }
+        else
+        {
+            beep();
+        }
+    }
+
+    nodelay(stdscr, true);
+
+    return accept;
+}
+
+/*******************************************************************************
+Show help popup
+*******************************************************************************/
 void popup_help()
 {
     const char * HELP_MSG =
@@ -420,12 +5565,30 @@ void popup_help()
         "  <PageDn>,b      - Scroll to next page\n"
         "  <PageUp>,n      - Scroll to previous page\n"
         "  <Home>,h        - Scroll to top\n"
-        "  <End>,e         - Scroll to end\n"
+        "  <End>,e         - Scroll to end and follow it\n"
         "  <,z             - Scroll to far left\n"
         "  >,x             - Scroll to far right\n"
+        "  -               - Add a pane, stack all panes\n"
+        "  |               - Add a pane, put all panes side by side\n"
+        "  <Tab>           - Move to next pane\n"
+        "  k               - Close pane\n"
         "  0 through 9     - Enter Goto Line Number Mode\n"
         "\n"
-        "In Goto Line Number Mode:\n"
+        "In Rate Mode:\n"
+        "  R               - Toggle rates next to or instead of numbers\n"
+        "                    (runs the command again to show it)\n"
+        "\n"
+        "In Table Mode:\n"
+        "  [,]             - Sort by previous/next column\n"
+        "  o               - Reverse sort order\n"
+        "  f               - Filter rows by sort column\n"
+        "\n"
+        "In Outline Mode:\n"
+        "  <Space>,<Enter> - Fold/unfold block at top row\n"
+        "  c               - Fold all nested blocks\n"
+        "  v               - Unfold all blocks\n"
+        "\n"
+        "In Goto Line Number Mode (shared, moves focused pane):\n"
         "  0 through 9     - Add digit to line number\n"
         "  <Backspace>     - Delete digit\n"
         "  <Esc>           - Exit mode\n"
@@ -443,7 +5606,7 @@ void popup_help()
         return;
     }
 
-    if (!(pad = newpad_buffer(HELP_MSG, NULL, NULL)))
+    if (!(pad = newpad_buffer(HELP_MSG, strlen(HELP_MSG), NULL, NULL)))
     {
         delwin(help);
 
@@ -471,69 +5634,292 @@ void popup_help()
         } while ((ch = wgetch(pad)) != -1 && ch != ESCAPE && ch != 'q');
     }
 
-    /* Cleanup */
-    delwin(help);
-    delwin(pad);
+    /* Cleanup */
+    delwin(help);
+    delwin(pad);
+}
+
+/*******************************************************************************
+Throttle command execution while nobody is watching
+
+After --idle minutes without a key press the interval doubles with every
+run, up to IDLE_MAX_INTERVAL. Runs stop entirely while the terminal reports
+that it lost focus (xterm focus reporting) or while gaze is in the
+background. Any key or focus event resumes with a fresh run.
+*******************************************************************************/
+#define KEY_FOCUS_IN  (KEY_MAX + 1)
+#define KEY_FOCUS_OUT (KEY_MAX + 2)
+
+struct
+{
+    int    minutes;
+    int    stretch;
+    bool   unfocused;
+    time_t input_time;
+} idle = { 0, 0, false, 0 };
+
+void idle_cleanup()
+{
+    /* Disable focus reporting */
+    fputs("\033[?1004l", stdout);
+    fflush(stdout);
+}
+
+void idle_init()
+{
+    define_key("\033[I", KEY_FOCUS_IN);
+    define_key("\033[O", KEY_FOCUS_OUT);
+
+    /* Enable focus reporting */
+    putp("\033[?1004h");
+    fflush(stdout);
+
+    idle.input_time = time(NULL);
+
+    atexit(idle_cleanup);
+}
+
+bool idle_background()
+{
+    pid_t pgrp = tcgetpgrp(STDIN_FILENO);
+
+    return pgrp != -1 && pgrp != getpgrp();
+}
+
+/* Return interval in seconds, zero while runs are suspended */
+int idle_interval()
+{
+    int interval;
+
+    if (!idle.minutes)
+    {
+        return global.interval;
+    }
+
+    if (idle.unfocused || idle_background())
+    {
+        return 0;
+    }
+
+    if (time(NULL) - idle.input_time < idle.minutes * 60)
+    {
+        return global.interval;
+    }
+
+    interval = global.interval << idle.stretch;
+
+    return (interval < IDLE_MAX_INTERVAL) ? interval : IDLE_MAX_INTERVAL;
+}
+
+/* Stretch interval further after a run while idle */
+void idle_ran()
+{
+    if (idle.minutes && idle_interval() != global.interval &&
+        (global.interval << idle.stretch) < IDLE_MAX_INTERVAL)
+    {
+        idle.stretch++;
+    }
+}
+
+/* Record key press or focus change, return true to run command now */
+bool idle_input(int ch)
+{
+    bool resume;
+
+    if (!idle.minutes)
+    {
+        return false;
+    }
+
+    resume = (idle_interval() != global.interval);
+
+    if (ch == KEY_FOCUS_OUT)
+    {
+        idle.unfocused = true;
+
+        return false;
+    }
+
+    idle.unfocused  = false;
+    idle.stretch    = 0;
+    idle.input_time = time(NULL);
+
+    return resume || ch == KEY_FOCUS_IN;
+}
+
+void idle_tag(char * tag, size_t size)
+{
+    int interval = memory_interval(idle_interval());
+
+    if (interval == 0)
+    {
+        snprintf(tag,
+                 size,
+                 "Paused (%s): ",
+                 idle.unfocused ? "unfocused" : "background");
+    }
+    else if (memory.pressure)
+    {
+        snprintf(tag, size, "Memory pressure, every %d seconds: ", interval);
+    }
+    else if (memory.above)
+    {
+        snprintf(tag, size, "Memory high, every %d seconds: ", interval);
+    }
+    else if (interval != global.interval)
+    {
+        snprintf(tag, size, "Idle, every %d seconds: ", interval);
+    }
+    else
+    {
+        snprintf(tag, size, "Every %d seconds: ", interval);
+    }
 }
 
 /*******************************************************************************
 Draw main window
 *******************************************************************************/
-void draw(WINDOW * pad, int top, int left, const char * cmd, bool lineno)
+void draw(WINDOW * pad, const char * cmd, bool lineno)
 {
+    int          first_row;
+    int          margin;
     int          digits;
+    char         tag[64];
+    char         stats[128];
     const char * cmd_time_str;
     int          cmd_time_str_len;
     int          cmd_len;
     int          len;
+    int          top;
+    int          left;
+    int          y;
+    int          x;
+    int          rows;
+    int          cols;
+    int          p;
     int          i;
 
-    cmd_time_str     = ctime(&global.cmd_time);
+    /* Low bandwidth mode shows when the visible rows last changed */
+    cmd_time_str     = ctime(lowbw.enabled ? &lowbw.change_time :
+                                             &global.cmd_time);
     cmd_time_str_len = strlen(cmd_time_str);
 
-#define TAG_LINE_CONST "Every %d seconds: "
+    split_tag(tag, sizeof(tag));
+    idle_tag(tag + strlen(tag), sizeof(tag) - strlen(tag));
+
+    len = (1 + COLS - cmd_time_str_len) - strlen(tag);
+
+    /* Statistics of the last run give way to the first columns of cmd */
+    run_tag(stats, sizeof(stats));
+
+    if ((int)strlen(stats) > len - 16)
+    {
+        stats[0] = '\0';
+    }
 
-    len = (1 + COLS - cmd_time_str_len) -
-          (sizeof(TAG_LINE_CONST) - 3 + global.interval_digits);
+    len -= strlen(stats);
 
     cmd_len = strnlen(cmd, len);
 
     erase();
 
-    mvprintw(0, 0, TAG_LINE_CONST "%.*s", global.interval, cmd_len, cmd);
-
-#undef TAG_LINE_CONST
+    mvprintw(0, 0, "%s%.*s", tag, cmd_len, cmd);
 
     for (i = 0; i < len - cmd_len; i++)
     {
         addch(' ');
     }
 
-    printw("%s", cmd_time_str);
+    printw("%s%s", stats, cmd_time_str);
 
-    if (lineno)
+    digits = global.lines_digits;
+    margin = ((lineno) ? digits + 1 : 0) + ((outline.enabled) ? 2 : 0);
+
+    for (p = 0; p < split.count; p++)
     {
-        digits = global.lines_digits;
+        pane_area(p, &y, &x, &rows, &cols);
+
+        top = split.panes[p].top_row;
 
-        for (i = 1; i < global.lines; i++)
+        /* Rows below the header, table mode pins the table header first */
+        first_row = y + rows - pane_rows(p);
+
+        if (p > 0)
         {
-            if (top + i > global.lines)
+            if (split.side_by_side)
             {
-                break;
+                mvvline(y, x - 1, ACS_VLINE, rows);
+            }
+            else
+            {
+                mvhline(y - 1, 0, ACS_HLINE, COLS);
             }
+        }
+
+        if (lineno)
+        {
+            for (i = 0; i < pane_rows(p) && top + i < global.lines; i++)
+            {
+                int line = row_line(top + i);
 
-            mvprintw(i, 0, "%*d:", digits, top + i);
+                if (line < 0)
+                {
+                    mvprintw(first_row + i, x, "%*s:", digits, "?");
+                }
+                else
+                {
+                    mvprintw(first_row + i, x, "%*d:", digits, line + 1);
+                }
+            }
+        }
+
+        /* Outline mode marks folds, the top row is the one toggled */
+        if (outline.enabled)
+        {
+            for (i = 0; i < pane_rows(p) && top + i < global.lines; i++)
+            {
+                mvaddch(first_row + i,
+                        x + margin - 2,
+                        outline_marker(top + i) |
+                            ((i == 0 && p == split.current) ? A_REVERSE : 0));
+            }
         }
-    }
-    else
-    {
-        digits = -1;
     }
 
     move(LINES - 1, COLS - 1);
     wnoutrefresh(stdscr);
-    pnoutrefresh(pad, top, left, 1, digits + 1, LINES - 1, COLS - 1);
-    doupdate();
+
+    for (p = 0; p < split.count; p++)
+    {
+        pane_area(p, &y, &x, &rows, &cols);
+
+        top       = split.panes[p].top_row;
+        left      = split.panes[p].left_col;
+        first_row = y + rows - pane_rows(p);
+
+        view_decorate(top, pane_rows(p));
+
+        if (table.enabled)
+        {
+            pnoutrefresh(table.header_pad,
+                         0,
+                         left,
+                         y,
+                         x + margin,
+                         y,
+                         x + cols - 1);
+        }
+
+        pnoutrefresh(pad,
+                     top,
+                     left,
+                     first_row,
+                     x + margin,
+                     y + rows - 1,
+                     x + cols - 1);
+    }
+
+    lowbw_doupdate();
 }
 
 /*******************************************************************************
@@ -542,13 +5928,37 @@ Print usage
 void usage()
 {
     puts("Usage: gaze [options] <command>\n"
+         "       gaze [options] --file <path>\n"
+         "       gaze [options] --plugin <library> [arguments]\n"
+         "       gaze [options] --attach <socket>\n"
          "\n"
          "Options:\n"
-         " -h, --help     Show this message\n"
-         " -l, --lineno   Number all output lines\n"
-         " -n, --interval Set command interval\n"
-         " -t, --timeout  Set command timeout\n"
-         " -b, --buffer   Set buffer size\n"
+         " -h, --help            Show this message\n"
+         " -l, --lineno          Number all output lines\n"
+         " -n, --interval        Set command interval\n"
+         " -t, --timeout         Set command timeout\n"
+         " -b, --buffer          Set buffer size\n"
+         "     --keep-tail       Keep end of output that exceeds buffer\n"
+         "     --memory-high     Shed caches and slow down above this size\n"
+         "     --file            Watch a file without running a command\n"
+         "     --plugin          Collect output from a shared library\n"
+         "     --on-change       Run command when a path changes (repeatable)\n"
+         "     --debounce        Milliseconds to wait for changes to settle\n"
+         "     --follow          Start at the end and follow it like End\n"
+         "     --table           Pin header row and sort rows by column\n"
+         "     --outline         Fold nested blocks of JSON or YAML\n"
+         "     --collapse        Show runs of repeated lines as one row\n"
+         "     --collapse-digits Same as --collapse ignoring digits\n"
+         "     --rate            Show per second change next to numbers\n"
+         "     --rate-only       Show per second change instead of numbers\n"
+         "     --highlight       Highlight text in output (repeatable)\n"
+         "     --highlight-file  Read highlight patterns from a file\n"
+         "     --idle            Slow down after minutes without input\n"
+         "     --low-bandwidth   Limit terminal output for slow links\n"
+         "     --max-fps         Limit frame rate (implies --low-bandwidth)\n"
+         "     --headless        Write frames or deltas to stdout, no curses\n"
+         "     --serve           Publish output on a Unix domain socket\n"
+         "     --attach          View output published by another gaze\n"
          "\n"
          "While running press F1 or '?' for help");
 
@@ -579,6 +5989,52 @@ bool parse_long(const char * arg, long * output, char ** endptr)
     return true;
 }
 
+/* Parse byte count with optional k, m or g suffix */
+bool parse_size(const char * arg, long * output)
+{
+    char * endptr;
+    long   scale;
+
+    if (!parse_long(arg, output, &endptr))
+    {
+        return false;
+    }
+
+    if (!*endptr)
+    {
+        return true;
+    }
+
+    if (endptr[1])
+    {
+        return false;
+    }
+
+    switch (*endptr)
+    {
+        case 'g':
+        case 'G': scale = 1024L * 1024 * 1024; break;
+        case 'm':
+        case 'M': scale = 1024L * 1024; break;
+        case 'k':
+        case 'K': scale = 1024L; break;
+        default:
+        {
+            return false;
+        }
+    }
+
+    /* Scaled value does not fit */
+    if (*output > LONG_MAX / scale || *output < LONG_MIN / scale)
+    {
+        return false;
+    }
+
+    *output *= scale;
+
+    return true;
+}
+
 bool option(const char * curt, const char * verbose, char * opt, char ** endptr)
 {
     if (strcmp(verbose, opt) == 0)
@@ -591,7 +6047,11 @@ bool option(const char * curt, const char * verbose, char * opt, char ** endptr)
         return true;
     }
 
-    if (!endptr)
+    if (!curt)
+    {
+        return false;
+    }
+    else if (!endptr)
     {
         if (strcmp(curt, opt) == 0)
         {
@@ -611,6 +6071,25 @@ bool option(const char * curt, const char * verbose, char * opt, char ** endptr)
     return false;
 }
 
+char * option_arg(int          argc,
+                  char *       argv[],
+                  int *        i,
+                  char *       endptr,
+                  const char * verbose)
+{
+    if (*endptr)
+    {
+        return endptr;
+    }
+
+    if (*i + 1 == argc)
+    {
+        exit_failed(2, "%s requires an argument", verbose);
+    }
+
+    return argv[++*i];
+}
+
 void parse_args(int argc, char * argv[])
 {
     int    arg_cmd;
@@ -635,127 +6114,278 @@ void parse_args(int argc, char * argv[])
         }
         else if (option("-n", "--interval", argv[i], &endptr))
         {
-            if (!*endptr)
-            {
-                if (i + 1 == argc)
-                {
-                    exit_failed(2, "--interval requires an argument");
-                }
+            opt_arg = option_arg(argc, argv, &i, endptr, "--interval");
 
-                opt_arg = argv[++i];
+            if (!parse_long(opt_arg, &tmp, NULL))
+            {
+                exit_failed(2, "Invalid interval: '%s'", opt_arg);
             }
-            else
+
+            if (tmp < 1 || tmp > 60)
             {
-                opt_arg = endptr;
+                exit_failed(2, "Interval out of range [1-60]");
             }
 
+            global.interval = (int)tmp;
+
+            continue;
+        }
+        else if (option("-t", "--timeout", argv[i], &endptr))
+        {
+            opt_arg = option_arg(argc, argv, &i, endptr, "--timeout");
+
             if (!parse_long(opt_arg, &tmp, NULL))
             {
-                exit_failed(2, "Invalid interval: '%s'", opt_arg);
+                exit_failed(2, "Invalid timeout: '%s'", opt_arg);
             }
 
             if (tmp < 1 || tmp > 60)
             {
-                exit_failed(2, "Interval out of range [1-60]");
+                exit_failed(2, "Timeout out of range [1-60]");
             }
 
-            global.interval        = (int)tmp;
-            global.interval_digits = count_int_chars(global.interval);
+            global.timeout = (int)tmp;
 
             continue;
         }
-        else if (option("-t", "--timeout", argv[i], &endptr))
+        else if (option("-b", "--buffer", argv[i], &endptr))
         {
-            if (!*endptr)
+            opt_arg = option_arg(argc, argv, &i, endptr, "--buffer");
+
+            if (!parse_size(opt_arg, &tmp))
             {
-                if (i + 1 == argc)
-                {
-                    exit_failed(2, "--timeout requires an argument");
-                }
+                exit_failed(2, "Invalid buffer size: '%s'", opt_arg);
+            }
 
-                opt_arg = argv[++i];
+            if (tmp < 0)
+            {
+                exit_failed(2, "Buffer size must be positive");
             }
-            else
+            else if (tmp < 2)
+            {
+                exit_failed(2, "Buffer size too small");
+            }
+            else if (tmp > INT32_MAX)
+            {
+                exit_failed(2, "Buffer size too large");
+            }
+
+            global.buffer_size = tmp;
+
+            continue;
+        }
+        else if (option(NULL, "--memory-high", argv[i], &endptr))
+        {
+            opt_arg = option_arg(argc, argv, &i, endptr, "--memory-high");
+
+            if (!parse_size(opt_arg, &tmp))
+            {
+                exit_failed(2, "Invalid memory threshold: '%s'", opt_arg);
+            }
+
+            if (tmp < 1024 * 1024)
+            {
+                exit_failed(2, "Memory threshold too small");
+            }
+            else if (tmp > INT32_MAX)
+            {
+                exit_failed(2, "Memory threshold too large");
+            }
+
+            memory.high = tmp;
+
+            continue;
+        }
+        else if (option(NULL, "--keep-tail", argv[i], &endptr))
+        {
+            opt_arg = option_arg(argc, argv, &i, endptr, "--keep-tail");
+
+            if (!parse_size(opt_arg, &tmp))
+            {
+                exit_failed(2, "Invalid tail size: '%s'", opt_arg);
+            }
+
+            if (tmp < 1)
+            {
+                exit_failed(2, "Tail size must be positive");
+            }
+            else if (tmp > INT32_MAX)
+            {
+                exit_failed(2, "Tail size too large");
+            }
+
+            global.keep_tail = tmp;
+
+            continue;
+        }
+        else if (option(NULL, "--table", argv[i], NULL))
+        {
+            table.enabled = true;
+
+            continue;
+        }
+        else if (option(NULL, "--follow", argv[i], NULL))
+        {
+            tail.anchored = true;
+
+            continue;
+        }
+        else if (option(NULL, "--outline", argv[i], NULL))
+        {
+            outline.enabled = true;
+
+            continue;
+        }
+        else if (option(NULL, "--collapse", argv[i], NULL))
+        {
+            collapse.enabled = true;
+
+            continue;
+        }
+        else if (option(NULL, "--collapse-digits", argv[i], NULL))
+        {
+            collapse.enabled = true;
+            collapse.digits  = true;
+
+            continue;
+        }
+        else if (option(NULL, "--rate", argv[i], NULL))
+        {
+            rate.enabled = true;
+
+            continue;
+        }
+        else if (option(NULL, "--rate-only", argv[i], NULL))
+        {
+            rate.enabled = true;
+            rate.replace = true;
+
+            continue;
+        }
+        else if (option(NULL, "--idle", argv[i], &endptr))
+        {
+            opt_arg = option_arg(argc, argv, &i, endptr, "--idle");
+
+            if (!parse_long(opt_arg, &tmp, NULL))
+            {
+                exit_failed(2, "Invalid idle time: '%s'", opt_arg);
+            }
+
+            if (tmp < 1 || tmp > 1440)
             {
-                opt_arg = endptr;
+                exit_failed(2, "Idle time out of range [1-1440]");
             }
 
+            idle.minutes = (int)tmp;
+
+            continue;
+        }
+        else if (option(NULL, "--low-bandwidth", argv[i], NULL))
+        {
+            lowbw.enabled = true;
+
+            continue;
+        }
+        else if (option(NULL, "--max-fps", argv[i], &endptr))
+        {
+            opt_arg = option_arg(argc, argv, &i, endptr, "--max-fps");
+
             if (!parse_long(opt_arg, &tmp, NULL))
             {
-                exit_failed(2, "Invalid timeout: '%s'", opt_arg);
+                exit_failed(2, "Invalid frame rate: '%s'", opt_arg);
             }
 
             if (tmp < 1 || tmp > 60)
             {
-                exit_failed(2, "Timeout out of range [1-60]");
+                exit_failed(2, "Frame rate out of range [1-60]");
             }
 
-            global.timeout = (int)tmp;
+            lowbw.enabled = true;
+            lowbw.max_fps = (int)tmp;
+
+            continue;
+        }
+        else if (option(NULL, "--headless", argv[i], &endptr))
+        {
+            opt_arg = option_arg(argc, argv, &i, endptr, "--headless");
+
+            if (strcmp(opt_arg, "frames") == 0)
+            {
+                headless.format = HEADLESS_FRAMES;
+            }
+            else if (strcmp(opt_arg, "delta") == 0)
+            {
+                headless.format = HEADLESS_DELTA;
+            }
+            else
+            {
+                exit_failed(2, "Invalid headless format: '%s'", opt_arg);
+            }
+
+            continue;
+        }
+        else if (option(NULL, "--serve", argv[i], &endptr))
+        {
+            global.serve_path = option_arg(argc, argv, &i, endptr, "--serve");
+
+            continue;
+        }
+        else if (option(NULL, "--file", argv[i], &endptr))
+        {
+            global.file_path = option_arg(argc, argv, &i, endptr, "--file");
+
+            continue;
+        }
+        else if (option(NULL, "--plugin", argv[i], &endptr))
+        {
+            global.plugin_path =
+                option_arg(argc, argv, &i, endptr, "--plugin");
+
+            continue;
+        }
+        else if (option(NULL, "--highlight", argv[i], &endptr))
+        {
+            opt_arg = option_arg(argc, argv, &i, endptr, "--highlight");
+
+            highlight_add(opt_arg, strlen(opt_arg), A_REVERSE, 0);
+
+            continue;
+        }
+        else if (option(NULL, "--highlight-file", argv[i], &endptr))
+        {
+            highlight_load(
+                option_arg(argc, argv, &i, endptr, "--highlight-file"));
+
+            continue;
+        }
+        else if (option(NULL, "--on-change", argv[i], &endptr))
+        {
+            on_change_add(option_arg(argc, argv, &i, endptr, "--on-change"));
 
             continue;
         }
-        else if (option("-b", "--buffer", argv[i], &endptr))
+        else if (option(NULL, "--debounce", argv[i], &endptr))
         {
-            if (!*endptr)
-            {
-                if (i + 1 == argc)
-                {
-                    exit_failed(2, "--buffer requires an argument");
-                }
-
-                opt_arg = argv[++i];
-            }
-            else
-            {
-                opt_arg = endptr;
-            }
-
-            if (!parse_long(opt_arg, &tmp, &endptr))
-            {
-                exit_failed(2, "Invalid buffer size: '%s'", opt_arg);
-            }
+            opt_arg = option_arg(argc, argv, &i, endptr, "--debounce");
 
-            if (tmp > INT32_MAX)
+            if (!parse_long(opt_arg, &tmp, NULL))
             {
-                exit_failed(2, "Buffer size too large");
+                exit_failed(2, "Invalid debounce: '%s'", opt_arg);
             }
 
-            if (*endptr)
+            if (tmp < 0 || tmp > 10000)
             {
-                if (endptr[1])
-                {
-                    exit_failed(2, "Invalid buffer size: '%s'", opt_arg);
-                }
-
-                switch (*endptr)
-                {
-                    case 'g':
-                    case 'G': tmp *= 1024; /* fall through */
-                    case 'm':
-                    case 'M': tmp *= 1024; /* fall through */
-                    case 'k':
-                    case 'K': tmp *= 1024; break;
-                    default:
-                    {
-                        exit_failed(2, "Invalid buffer size: '%s'", opt_arg);
-                    }
-                }
+                exit_failed(2, "Debounce out of range [0-10000]");
             }
 
-            if (tmp < 0)
-            {
-                exit_failed(2, "Buffer size must be positive");
-            }
-            else if (tmp < 2)
-            {
-                exit_failed(2, "Buffer size too small");
-            }
-            else if (tmp > INT32_MAX)
-            {
-                exit_failed(2, "Buffer size too large");
-            }
+            on_change.debounce = (int)tmp;
 
-            global.buffer_size = tmp;
+            continue;
+        }
+        else if (option(NULL, "--attach", argv[i], &endptr))
+        {
+            global.attach_path =
+                option_arg(argc, argv, &i, endptr, "--attach");
 
             continue;
         }
@@ -767,7 +6397,69 @@ void parse_args(int argc, char * argv[])
         break;
     }
 
-    if (i == argc)
+    if (global.serve_path && global.attach_path)
+    {
+        exit_failed(2, "--serve and --attach are mutually exclusive");
+    }
+
+    if (global.file_path && global.attach_path)
+    {
+        exit_failed(2, "--file and --attach are mutually exclusive");
+    }
+
+    if (headless.format && (global.attach_path || table.enabled ||
+                            outline.enabled))
+    {
+        exit_failed(2,
+                    "--headless cannot be used with --attach, --table or "
+                    "--outline");
+    }
+
+    if (table.enabled + outline.enabled + collapse.enabled > 1)
+    {
+        exit_failed(2,
+                    "--table, --outline and --collapse are mutually "
+                    "exclusive");
+    }
+
+    if (global.keep_tail >= global.buffer_size - 1)
+    {
+        exit_failed(2, "Tail size must be smaller than buffer size");
+    }
+
+    if (global.plugin_path && (global.file_path || global.attach_path))
+    {
+        exit_failed(2, "--plugin replaces the command source");
+    }
+
+    if (on_change.count && (global.file_path || global.attach_path))
+    {
+        exit_failed(2, "--on-change requires a command");
+    }
+
+    if (global.attach_path)
+    {
+        if (i != argc)
+        {
+            exit_failed(2, "--attach does not take a command");
+        }
+
+        return;
+    }
+
+    if (global.file_path)
+    {
+        if (i != argc)
+        {
+            exit_failed(2, "--file does not take a command");
+        }
+
+        global.cmd = global.file_path;
+
+        return;
+    }
+
+    if (i == argc && !global.plugin_path)
     {
         usage();
     }
@@ -792,6 +6484,31 @@ void parse_args(int argc, char * argv[])
         strcat(global.cmd, argv[i]);
         strcat(global.cmd, " ");
     }
+
+    /* Pass arguments to plugin, show plugin and arguments in header */
+    if (global.plugin_path)
+    {
+        char * cmd;
+
+        size = strlen(global.cmd);
+
+        if (size)
+        {
+            global.cmd[size - 1] = '\0';
+        }
+
+        size += strlen(global.plugin_path) + 2;
+
+        if (!(cmd = (char *)malloc(size)))
+        {
+            exit_failed(2, "malloc() failed");
+        }
+
+        snprintf(cmd, size, "%s %s", global.plugin_path, global.cmd);
+
+        plugin.arg = global.cmd;
+        global.cmd = cmd;
+    }
 }
 
 /*******************************************************************************
@@ -803,6 +6520,40 @@ int main(int argc, char * argv[])
     parse_args(argc, argv);
     /* Install signal handlers */
     handle_signals();
+    /* Open socket before taking over the terminal */
+    if (global.serve_path)
+    {
+        serve_init();
+    }
+    else if (global.attach_path)
+    {
+        attach_init();
+    }
+    /* Watch file for changes */
+    if (global.file_path)
+    {
+        file_init();
+    }
+    /* Measure terminal output */
+    if (lowbw.enabled)
+    {
+        lowbw_init();
+    }
+    /* Load plugin */
+    if (global.plugin_path)
+    {
+        plugin_init();
+    }
+    /* Watch paths that trigger command execution */
+    if (on_change.count)
+    {
+        on_change_init();
+    }
+    /* Write snapshots to stdout without curses */
+    if (headless.format)
+    {
+        headless_main();
+    }
 
     /* Required for UTF-8 support */
     setlocale(LC_ALL, "");
@@ -824,19 +6575,68 @@ int main(int argc, char * argv[])
     nodelay(stdscr, true);
     /* Use hardware's insert/delete line features */
     idlok(stdscr, true);
+    /* Compile highlight patterns, colors require curses */
+    if (highlight.rule_count)
+    {
+        highlight_init();
+    }
+    /* Detect inactivity */
+    if (idle.minutes)
+    {
+        idle_init();
+    }
 
     while (1)
     {
-        static int             top_row       = 0;
-        static int             left_col      = 0;
         static struct timespec last_cmd_time = { 0, 0 };
         static WINDOW *        pad = NULL; /* Initializing fixes warning */
+        static bool            dirty = true;
+        struct pane *          pane;
+        bool                   updated;
         int                    ch;
 
+        updated = false;
+
+        /* Scrolling keys move the focused pane */
+        pane = &split.panes[split.current];
+
+        /* Hand snapshots to new clients and to clients still reading */
+        if (global.serve_path)
+        {
+            serve_accept();
+        }
+
+        /* Drop state kept to save work while memory is short */
+        if (memory_check())
+        {
+            bool view_freed  = view_shed();
+            bool table_freed = table_shed();
+
+            if (view_freed || table_freed)
+            {
+                memory_trim();
+            }
+
+            memory_shed_done();
+        }
+
+        /* Show snapshot received from server */
+        if (global.attach_path)
+        {
+            if (attach_receive())
+            {
+                pad = newpad_snapshot(attach.last, attach.last_size);
+
+                updated = true;
+            }
+        }
         /* Run command if interval has elapsed */
+        else
         {
             struct timespec poll_time;
             uint64_t        elapsed;
+            int             interval;
+            bool            changed;
 
             /* Calculate time since last command execution */
             clock_gettime(CLOCK_MONOTONIC, &poll_time);
@@ -847,8 +6647,21 @@ int main(int argc, char * argv[])
             elapsed /= UINT64_C(1000000000);
 
             /* If interval has elapsed then schedule command execution */
-            if ((int)elapsed >= global.interval)
+            /* Files watched by inotify are only read when changed */
+            /* Nothing runs while idle throttling has suspended runs */
+            interval = memory_interval(idle_interval());
+
+            /* Events are read every pass so a run also covers those pending */
+            changed = on_change.count && on_change_due();
+
+            if (interval && (((int)elapsed >= interval &&
+                              (!global.file_path || file_changed())) ||
+                             changed))
             {
+                on_change.pending = false;
+
+                idle_ran();
+
                 /* Create pad from command output */
                 pad = newpad_cmd(global.cmd);
 
@@ -857,22 +6670,42 @@ int main(int argc, char * argv[])
 
                 global.cmd_time = time(NULL);
 
-                if (top_row > (global.lines - LINES + 1))
-                {
-                    if (global.lines > LINES)
-                    {
-                        top_row = (global.lines - LINES + 1);
-                    }
-                    else
-                    {
-                        top_row = 0;
-                    }
-                }
+                updated = true;
+            }
+        }
+
+        if (updated)
+        {
+            split_clamp(false);
+
+            /* Pads built from the end are shown from their last lines */
+            if (tail.active)
+            {
+                pane->top_row = tail_top();
+            }
+
+            /* Skip frames for changes outside of the visible rows */
+            if (!lowbw.enabled || split_visible_changed())
+            {
+                lowbw.change_time = global.cmd_time;
+
+                dirty = true;
             }
         }
 
-        /* Update screen */
-        draw(pad, top_row, left_col, global.cmd, global.show_lineno);
+        /* Update screen, at most max_fps times per second if limited */
+        if (dirty && lowbw_frame_due())
+        {
+            draw(pad, global.cmd, global.show_lineno);
+
+            dirty = false;
+        }
+
+        /* Line numbers appear once counted when following the end */
+        if (tail_count() && global.show_lineno)
+        {
+            dirty = true;
+        }
 
         /* Read key, delay between reads, handle line number entry */
         while (1)
@@ -882,6 +6715,19 @@ int main(int argc, char * argv[])
 
             ch = getch();
 
+            /* Build the full view before scrolling away from the end */
+            if (tail.anchored && tail_leaves(ch))
+            {
+                tail.anchored = false;
+
+                if (tail.active)
+                {
+                    pad = tail_expand();
+
+                    pane->top_row = tail_top();
+                }
+            }
+
             if (ch == -1)
             {
                 napms(50); /* Delay 50ms */
@@ -942,17 +6788,17 @@ int main(int argc, char * argv[])
             {
                 if (ch != ESCAPE && line_number != 0)
                 {
-                    top_row = line_number - 1;
+                    pane->top_row = line_row(line_number - 1);
 
-                    if (top_row > (global.lines - LINES + 1))
+                    if (pane->top_row > (global.lines - view_rows()))
                     {
-                        if (global.lines > LINES)
+                        if (global.lines > view_rows() + 1)
                         {
-                            top_row = (global.lines - LINES + 1);
+                            pane->top_row = (global.lines - view_rows());
                         }
                         else
                         {
-                            top_row = 0;
+                            pane->top_row = 0;
                         }
                     }
                 }
@@ -960,6 +6806,7 @@ int main(int argc, char * argv[])
                 goto_line_number = false;
                 line_number      = 0;
                 ch               = -1;
+                dirty            = true;
 
                 break;
             }
@@ -970,6 +6817,17 @@ int main(int argc, char * argv[])
         }
 
         /* Process keys */
+        if (ch != -1)
+        {
+            dirty = true;
+
+            /* Run now when returning from idle */
+            if (idle_input(ch))
+            {
+                memset(&last_cmd_time, 0, sizeof(last_cmd_time));
+            }
+        }
+
         switch (ch)
         {
             case -1:
@@ -982,39 +6840,36 @@ int main(int argc, char * argv[])
 
                 break;
             }
+            case KEY_FOCUS_IN:
+            case KEY_FOCUS_OUT:
+            {
+                break;
+            }
             case KEY_RESIZE:
             {
-                if (left_col != 0)
-                {
-                    if (left_col + COLS > global.display_cols)
-                    {
-                        left_col = global.display_cols - COLS;
-                    }
-                }
+                /* Panes that no longer fit are closed */
+                split_fit();
 
-                if (top_row != 0)
+                /* Number of lines kept at the end depends on screen size */
+                if (tail.active)
                 {
-                    if (top_row > (global.lines - LINES + 1))
-                    {
-                        top_row = global.lines - LINES + 1;
-                    }
+                    pad = newpad_tail(tail.text, tail.size);
 
-                    if (top_row < 0)
-                    {
-                        top_row = 0;
-                    }
+                    pane->top_row = tail_top();
                 }
 
+                split_clamp(true);
+
                 break;
             }
             case KEY_UP:
             case 'w':
             {
-                top_row--;
+                pane->top_row--;
 
-                if (top_row < 0)
+                if (pane->top_row < 0)
                 {
-                    top_row = 0;
+                    pane->top_row = 0;
                 }
 
                 break;
@@ -1022,9 +6877,9 @@ int main(int argc, char * argv[])
             case KEY_DOWN:
             case 's':
             {
-                if (top_row < (global.lines - LINES + 1))
+                if (pane->top_row < (global.lines - view_rows()))
                 {
-                    top_row++;
+                    pane->top_row++;
                 }
 
                 break;
@@ -1032,11 +6887,11 @@ int main(int argc, char * argv[])
             case KEY_LEFT:
             case 'a':
             {
-                left_col--;
+                pane->left_col--;
 
-                if (left_col < 0)
+                if (pane->left_col < 0)
                 {
-                    left_col = 0;
+                    pane->left_col = 0;
                 }
 
                 break;
@@ -1044,9 +6899,9 @@ int main(int argc, char * argv[])
             case KEY_RIGHT:
             case 'd':
             {
-                if (left_col + COLS < global.display_cols)
+                if (pane->left_col + view_cols() < global.display_cols)
                 {
-                    left_col++;
+                    pane->left_col++;
                 }
 
                 break;
@@ -1054,28 +6909,28 @@ int main(int argc, char * argv[])
             case KEY_HOME:
             case 'h':
             {
-                if (top_row == 0)
+                if (pane->top_row == 0)
                 {
-                    left_col = 0;
+                    pane->left_col = 0;
                 }
 
-                top_row = 0;
+                pane->top_row = 0;
 
                 break;
             }
             case '<':
             case 'z':
             {
-                left_col = 0;
+                pane->left_col = 0;
 
                 break;
             }
             case '>':
             case 'x':
             {
-                if (COLS < global.display_cols)
+                if (view_cols() < global.display_cols)
                 {
-                    left_col = global.display_cols - COLS;
+                    pane->left_col = global.display_cols - view_cols();
                 }
 
                 break;
@@ -1085,30 +6940,37 @@ int main(int argc, char * argv[])
             {
                 bool bottom = false;
 
-                if (global.lines > LINES)
+                /* Following the end starts with the next snapshot */
+                /* Panes share one pad so it is only followed unsplit */
+                if (split.count == 1)
                 {
-                    if (top_row == (global.lines - LINES + 1))
+                    tail.anchored = true;
+                }
+
+                if (global.lines > view_rows() + 1)
+                {
+                    if (pane->top_row == (global.lines - view_rows()))
                     {
                         bottom = true;
                     }
 
-                    top_row = (global.lines - LINES + 1);
+                    pane->top_row = (global.lines - view_rows());
                 }
                 else
                 {
-                    if (top_row == (global.lines - 2))
+                    if (pane->top_row == (global.lines - 2))
                     {
                         bottom = true;
                     }
 
-                    top_row = (global.lines - 2);
+                    pane->top_row = (global.lines - 2);
                 }
 
                 if (bottom)
                 {
-                    if (COLS < global.display_cols)
+                    if (view_cols() < global.display_cols)
                     {
-                        left_col = global.display_cols - COLS;
+                        pane->left_col = global.display_cols - view_cols();
                     }
                 }
 
@@ -1117,17 +6979,18 @@ int main(int argc, char * argv[])
             case KEY_NPAGE:
             case 'n':
             {
-                if ((top_row + (LINES - 1)) < (global.lines - LINES + 1))
+                if ((pane->top_row + view_rows()) <
+                    (global.lines - view_rows()))
                 {
-                    top_row += (LINES - 1);
+                    pane->top_row += view_rows();
                 }
-                else if (global.lines >= LINES)
+                else if (global.lines >= view_rows() + 1)
                 {
-                    top_row = (global.lines - LINES + 1);
+                    pane->top_row = (global.lines - view_rows());
                 }
                 else
                 {
-                    top_row = 0;
+                    pane->top_row = 0;
                 }
 
                 break;
@@ -1135,13 +6998,13 @@ int main(int argc, char * argv[])
             case KEY_PPAGE:
             case 'b':
             {
-                if (top_row >= LINES)
+                if (pane->top_row >= view_rows() + 1)
                 {
-                    top_row -= (LINES - 1);
+                    pane->top_row -= view_rows();
                 }
                 else
                 {
-                    top_row = 0;
+                    pane->top_row = 0;
                 }
 
                 break;
@@ -1153,11 +7016,146 @@ int main(int argc, char * argv[])
 
                 break;
             }
+            case '[':
+            case ']':
+            case 'o':
+            case 'f':
+            {
+                if (!table.enabled)
+                {
+                    beep();
+
+                    break;
+                }
+
+                if (ch == '[')
+                {
+                    /* Column -1 restores the original order */
+                    if (table.sort_column > -1)
+                    {
+                        table.sort_column--;
+                    }
+                }
+                else if (ch == ']')
+                {
+                    if (table.sort_column < table.columns - 1)
+                    {
+                        table.sort_column++;
+                    }
+                }
+                else if (ch == 'o')
+                {
+                    table.descending = !table.descending;
+                }
+                else if (!prompt("Filter: ",
+                                 table.filter,
+                                 (int)sizeof(table.filter)))
+                {
+                    table.filter[0] = '\0';
+                }
+
+                table_sort();
+
+                pad = newpad_table();
+
+                split_clamp(false);
+
+                break;
+            }
+            case ' ':
+            case '\r':
+            case KEY_ENTER:
+            case 'c':
+            case 'v':
+            {
+                int lines[MAX_PANES];
+                int i;
+
+                if (!outline.enabled)
+                {
+                    beep();
+
+                    break;
+                }
+
+                if (ch == 'c' || ch == 'v')
+                {
+                    outline_fold_all(ch == 'c');
+                }
+                else if (!outline_toggle(pane->top_row))
+                {
+                    break;
+                }
+
+                /* Keep the top rows on the same source lines */
+                for (i = 0; i < split.count; i++)
+                {
+                    lines[i] = row_line(split.panes[i].top_row);
+                }
+
+                pad = newpad_outline();
+
+                for (i = 0; i < split.count; i++)
+                {
+                    split.panes[i].top_row = line_row(lines[i]);
+                }
+
+                split_clamp(false);
+
+                break;
+            }
+            case 'R':
+            {
+                if (!rate.enabled)
+                {
+                    beep();
+
+                    break;
+                }
+
+                /* Takes effect with the next snapshot, take one now */
+                rate.replace = !rate.replace;
+
+                memset(&last_cmd_time, 0, sizeof(last_cmd_time));
+
+                file.stale = true;
+
+                break;
+            }
+            case '-':
+            case '|':
+            {
+                if (!split_open(ch == '|'))
+                {
+                    beep();
+                }
+
+                break;
+            }
+            case '\t':
+            {
+                split.current = (split.current + 1) % split.count;
+
+                break;
+            }
+            case 'k':
+            {
+                if (!split_close())
+                {
+                    beep();
+                }
+
+                split_clamp(false);
+
+                break;
+            }
             case KEY_F(5):
             case 'r':
             {
                 memset(&last_cmd_time, 0, sizeof(last_cmd_time));
 
+                file.stale = true;
+
                 break;
             }
             case ESCAPE:
@@ -0,0 +1,50 @@
+/*******************************************************************************
+ gaze - Another scrollable watch command
+ Copyright (c) 2025 Aaron Clovsky
+
+ Plugin interface, see LICENSE for terms
+*******************************************************************************/
+#ifndef GAZE_PLUGIN_H
+#define GAZE_PLUGIN_H
+
+/*******************************************************************************
+A plugin is a shared object loaded with --plugin that fills the output
+buffer directly instead of gaze running a command through the shell.
+
+gaze calls gaze_plugin_init() once with the rest of the command line,
+gaze_plugin_collect() every interval and gaze_plugin_close() before exiting.
+All calls are made from the main thread, collect() must not block for long
+since it runs in gaze's own process and is not subject to --timeout.
+
+Any change to these declarations increments GAZE_PLUGIN_ABI_VERSION.
+*******************************************************************************/
+#include <stddef.h>
+
+#define GAZE_PLUGIN_ABI_VERSION (1)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Return GAZE_PLUGIN_ABI_VERSION as seen when the plugin was built */
+typedef int gaze_plugin_abi_fn(void);
+
+/* Prepare plugin state, return 0 on success */
+typedef int gaze_plugin_init_fn(const char * arg, void ** state);
+
+/* Write at most size bytes to buffer, return bytes written or -1 on error */
+typedef long gaze_plugin_collect_fn(void * state, char * buffer, size_t size);
+
+/* Release plugin state */
+typedef void gaze_plugin_close_fn(void * state);
+
+gaze_plugin_abi_fn     gaze_plugin_abi;
+gaze_plugin_init_fn    gaze_plugin_init;
+gaze_plugin_collect_fn gaze_plugin_collect;
+gaze_plugin_close_fn   gaze_plugin_close;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
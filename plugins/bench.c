@@ -0,0 +1,164 @@
+/*******************************************************************************
+ gaze - Another scrollable watch command
+ Copyright (c) 2025 Aaron Clovsky
+
+ Benchmark: plugin collection versus running a command, see LICENSE for terms
+********************************************************************************
+ Usage: bench <plugin.so> <command> [iterations]
+
+ Times gaze_plugin_collect() against the fork/exec/pipe path gaze uses for
+ commands, both filling a buffer of the default size.
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dlfcn.h>
+#include <sys/wait.h>
+#include "gaze_plugin.h"
+
+#define BUFFER_SIZE (16 * 1024 * 1024)
+
+double now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+size_t run_cmd(const char * cmd, char * buffer, size_t size)
+{
+    int     pipefd[2];
+    pid_t   pid;
+    ssize_t retval;
+    size_t  used;
+
+    if (pipe(pipefd) == -1)
+    {
+        return 0;
+    }
+
+    if (!(pid = fork()))
+    {
+        dup2(pipefd[1], 1);
+        close(pipefd[0]);
+        close(pipefd[1]);
+
+        execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+
+        _Exit(127);
+    }
+
+    close(pipefd[1]);
+
+    used = 0;
+
+    while ((retval = read(pipefd[0], &buffer[used], size - used)) > 0)
+    {
+        used += retval;
+    }
+
+    close(pipefd[0]);
+
+    waitpid(pid, NULL, 0);
+
+    return used;
+}
+
+int main(int argc, char * argv[])
+{
+    gaze_plugin_init_fn *    init;
+    gaze_plugin_collect_fn * collect;
+    gaze_plugin_close_fn *   close_plugin;
+    void *                   handle;
+    void *                   state;
+    char *                   buffer;
+    double                   start;
+    double                   plugin_time;
+    double                   cmd_time;
+    size_t                   plugin_bytes;
+    size_t                   cmd_bytes;
+    int                      iterations;
+    int                      i;
+
+    if (argc < 3)
+    {
+        puts("Usage: bench <plugin.so> <command> [iterations]");
+
+        return 2;
+    }
+
+    iterations = (argc > 3) ? atoi(argv[3]) : 1000;
+
+    if (iterations < 1)
+    {
+        iterations = 1;
+    }
+
+    if (!(handle = dlopen(argv[1], RTLD_NOW | RTLD_LOCAL)))
+    {
+        printf("%s\n", dlerror());
+
+        return 1;
+    }
+
+    init         = (gaze_plugin_init_fn *)dlsym(handle, "gaze_plugin_init");
+    collect      = (gaze_plugin_collect_fn *)dlsym(handle,
+                                                   "gaze_plugin_collect");
+    close_plugin = (gaze_plugin_close_fn *)dlsym(handle, "gaze_plugin_close");
+
+    if (!init || !collect || !close_plugin || init("", &state) != 0)
+    {
+        puts("Failed to initialize plugin");
+
+        return 1;
+    }
+
+    if (!(buffer = (char *)malloc(BUFFER_SIZE)))
+    {
+        return 1;
+    }
+
+    /* Plugin path */
+    plugin_bytes = 0;
+    start        = now();
+
+    for (i = 0; i < iterations; i++)
+    {
+        plugin_bytes += collect(state, buffer, BUFFER_SIZE);
+    }
+
+    plugin_time = now() - start;
+
+    /* Shell path */
+    cmd_bytes = 0;
+    start     = now();
+
+    for (i = 0; i < iterations; i++)
+    {
+        cmd_bytes += run_cmd(argv[2], buffer, BUFFER_SIZE);
+    }
+
+    cmd_time = now() - start;
+
+    printf("%-8s %12s %14s\n", "source", "usec/run", "bytes/run");
+    printf("%-8s %12.1f %14zu\n",
+           "plugin",
+           plugin_time * 1e6 / iterations,
+           plugin_bytes / iterations);
+    printf("%-8s %12.1f %14zu\n",
+           "command",
+           cmd_time * 1e6 / iterations,
+           cmd_bytes / iterations);
+    printf("speedup  %12.1fx\n", cmd_time / plugin_time);
+
+    close_plugin(state);
+    dlclose(handle);
+    free(buffer);
+
+    return 0;
+}
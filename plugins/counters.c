@@ -0,0 +1,117 @@
+/*******************************************************************************
+ gaze - Another scrollable watch command
+ Copyright (c) 2025 Aaron Clovsky
+
+ Example plugin: process counters from procfs, see LICENSE for terms
+********************************************************************************
+ Usage: gaze --plugin plugins/counters.so [pid]
+
+ Shows /proc/<pid>/status, /proc/<pid>/io and /proc/<pid>/schedstat, the pid
+ defaults to gaze itself. Files are opened once and re-read with pread() so
+ every interval costs three system calls.
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "gaze_plugin.h"
+
+static const char * FILES[] = { "status", "io", "schedstat" };
+
+#define FILE_COUNT (sizeof(FILES) / sizeof(FILES[0]))
+
+struct counters
+{
+    int fds[FILE_COUNT];
+};
+
+int gaze_plugin_abi(void)
+{
+    return GAZE_PLUGIN_ABI_VERSION;
+}
+
+int gaze_plugin_init(const char * arg, void ** state)
+{
+    struct counters * counters;
+    char              path[64];
+    const char *      pid;
+    size_t            i;
+
+    pid = (arg && *arg) ? arg : "self";
+
+    if (!(counters = (struct counters *)malloc(sizeof(*counters))))
+    {
+        return -1;
+    }
+
+    for (i = 0; i < FILE_COUNT; i++)
+    {
+        snprintf(path, sizeof(path), "/proc/%s/%s", pid, FILES[i]);
+
+        /* Missing files (e.g. io without permission) are skipped */
+        counters->fds[i] = open(path, O_RDONLY);
+    }
+
+    *state = counters;
+
+    return 0;
+}
+
+long gaze_plugin_collect(void * state, char * buffer, size_t size)
+{
+    struct counters * counters = (struct counters *)state;
+    size_t            used;
+    size_t            i;
+
+    used = 0;
+
+    for (i = 0; i < FILE_COUNT; i++)
+    {
+        ssize_t retval;
+        int     len;
+
+        len = snprintf(&buffer[used], size - used, "[%s]\n", FILES[i]);
+
+        if (len < 0 || (size_t)len >= size - used)
+        {
+            break;
+        }
+
+        used += len;
+
+        if (counters->fds[i] == -1)
+        {
+            continue;
+        }
+
+        retval = pread(counters->fds[i], &buffer[used], size - used, 0);
+
+        if (retval > 0)
+        {
+            used += retval;
+        }
+
+        if (used < size)
+        {
+            buffer[used++] = '\n';
+        }
+    }
+
+    return (long)used;
+}
+
+void gaze_plugin_close(void * state)
+{
+    struct counters * counters = (struct counters *)state;
+    size_t            i;
+
+    for (i = 0; i < FILE_COUNT; i++)
+    {
+        if (counters->fds[i] != -1)
+        {
+            close(counters->fds[i]);
+        }
+    }
+
+    free(counters);
+}
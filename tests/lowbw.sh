@@ -0,0 +1,19 @@
+#!/bin/sh
+# Snapshots that did not change must not be drawn again in low bandwidth mode
+
+gaze=${1:-./gaze}
+
+# Input is kept open, script passes end of file on as a key press
+report=$(sleep 6 |
+         script -qec "timeout -s INT 5 $gaze --low-bandwidth -n 1 'seq 1 5'" \
+                /dev/null | tr -d '\r' | grep -o 'gaze: .*')
+
+case "$report" in
+    *" in 1 frames")
+        echo " unchanged snapshots: ok"
+        ;;
+    *)
+        echo " unchanged snapshots: FAILED ($report)"
+        exit 1
+        ;;
+esac